@@ -0,0 +1,483 @@
+/*
+ * Encode/decode benchmark for the serialization codecs in the tree:
+ *
+ *     bstream          nodeoze::bstream (ombstream/imbstream)
+ *     msgpack-c        the vendored msgpack-c, packing native types directly
+ *     mpack            nodeoze::mpack, via nodeoze::any
+ *     json             nodeoze::json (rapidjson), via nodeoze::any
+ *
+ * Each representative type is encoded and decoded through every codec that
+ * has a natural mapping for it. Reported per operation: wall time, encoded
+ * size, and heap allocations (counted by replacing global operator new in
+ * this executable).
+ *
+ * usage: nodeoze_bench [ filter ] [ min_ms ]
+ *
+ * filter selects rows whose "type/codec" name contains the given substring;
+ * min_ms is the minimum measuring time per row (default 200).
+ */
+
+#include <nodeoze/bstream.h>
+#include <nodeoze/bstream/ombstream.h>
+#include <nodeoze/bstream/imbstream.h>
+#include <nodeoze/bstream/stdlib.h>
+#include <nodeoze/raft/log_frames.h>
+#include <nodeoze/msgpack.h>
+#include <nodeoze/json.h>
+#include <nodeoze/any.h>
+#include <msgpack.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace nodeoze;
+
+static std::atomic< std::size_t > g_allocations{ 0 };
+
+void*
+operator new( std::size_t size )
+{
+	g_allocations.fetch_add( 1, std::memory_order_relaxed );
+	if ( auto p = std::malloc( size ? size : 1 ) )
+	{
+		return p;
+	}
+	throw std::bad_alloc{};
+}
+
+void
+operator delete( void* p ) noexcept
+{
+	std::free( p );
+}
+
+void
+operator delete( void* p, std::size_t ) noexcept
+{
+	std::free( p );
+}
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+struct measurement
+{
+	double		ns_per_op;
+	double		allocs_per_op;
+};
+
+template< class T >
+inline void
+do_not_optimize( T const& value )
+{
+	asm volatile( "" : : "r,m"( value ) : "memory" );
+}
+
+std::chrono::milliseconds	g_min_time{ 200 };
+std::string					g_filter;
+
+template< class F >
+measurement
+measure( F&& f )
+{
+	f();	// warm up caches and any lazily built state
+
+	std::size_t iterations = 1;
+	while ( true )
+	{
+		auto allocs_before = g_allocations.load( std::memory_order_relaxed );
+		auto start = clock_type::now();
+		for ( auto i = 0u; i < iterations; ++i )
+		{
+			f();
+		}
+		auto elapsed = clock_type::now() - start;
+		auto allocs = g_allocations.load( std::memory_order_relaxed ) - allocs_before;
+
+		if ( elapsed >= g_min_time )
+		{
+			auto ns = std::chrono::duration_cast< std::chrono::nanoseconds >( elapsed ).count();
+			return measurement{ static_cast< double >( ns ) / iterations, static_cast< double >( allocs ) / iterations };
+		}
+		iterations *= 2;
+	}
+}
+
+std::size_t
+encoded_size( buffer const& buf )
+{
+	return buf.size();
+}
+
+std::size_t
+encoded_size( std::string const& s )
+{
+	return s.size();
+}
+
+std::size_t
+encoded_size( ::msgpack::sbuffer const& sbuf )
+{
+	return sbuf.size();
+}
+
+void
+print_header()
+{
+	std::cout << std::left << std::setw( 32 ) << "type/codec"
+			  << std::right << std::setw( 12 ) << "enc ns/op"
+			  << std::setw( 12 ) << "dec ns/op"
+			  << std::setw( 10 ) << "bytes"
+			  << std::setw( 12 ) << "enc allocs"
+			  << std::setw( 12 ) << "dec allocs" << std::endl;
+}
+
+/*
+ * encode() returns the encoded form; decode( encoded ) returns the decoded
+ * value, which is kept alive only long enough to defeat the optimizer.
+ */
+
+template< class Encode, class Decode >
+void
+run( std::string const& type, std::string const& codec, Encode&& encode, Decode&& decode )
+{
+	auto name = type + "/" + codec;
+	if ( ! g_filter.empty() && name.find( g_filter ) == std::string::npos )
+	{
+		return;
+	}
+
+	auto encoded = encode();
+	auto enc = measure( [&] () { do_not_optimize( encode() ); } );
+	auto dec = measure( [&] () { do_not_optimize( decode( encoded ) ); } );
+
+	std::cout << std::left << std::setw( 32 ) << name
+			  << std::right << std::fixed << std::setprecision( 1 )
+			  << std::setw( 12 ) << enc.ns_per_op
+			  << std::setw( 12 ) << dec.ns_per_op
+			  << std::setw( 10 ) << encoded_size( encoded )
+			  << std::setw( 12 ) << enc.allocs_per_op
+			  << std::setw( 12 ) << dec.allocs_per_op << std::endl;
+}
+
+template< class T >
+buffer
+bstream_encode( T const& value, bstream::context_base const& cntxt = bstream::get_default_context() )
+{
+	bstream::ombstream os{ 4096, cntxt };
+	os << value;
+	return os.get_buffer();
+}
+
+template< class T >
+T
+bstream_decode( buffer const& buf, bstream::context_base const& cntxt = bstream::get_default_context() )
+{
+	bstream::imbstream is{ buf, cntxt };
+	return is.read_as< T >();
+}
+
+template< class T >
+::msgpack::sbuffer
+msgpack_encode( T const& value )
+{
+	::msgpack::sbuffer sbuf;
+	::msgpack::pack( sbuf, value );
+	return sbuf;
+}
+
+template< class T >
+T
+msgpack_decode( ::msgpack::sbuffer const& sbuf )
+{
+	auto handle = ::msgpack::unpack( sbuf.data(), sbuf.size() );
+	return handle.get().as< T >();
+}
+
+void
+run_any_codecs( std::string const& type, any const& root )
+{
+	run( type, "mpack",
+		[&] () { return mpack::deflate( root ); },
+		[] ( buffer const& buf ) { return mpack::inflate( buf ); } );
+
+	run( type, "json",
+		[&] () { return json::deflate_to_string( root ); },
+		[] ( std::string const& s ) { return json::inflate( s ); } );
+}
+
+/*
+ * raft log frame: a state machine update with a small payload, serialized
+ * polymorphically through the log context as the log itself does.
+ */
+
+void
+bench_raft_frame()
+{
+	std::string type{ "raft_frame" };
+	buffer payload{ 256 };
+	for ( auto i = 0u; i < payload.size(); ++i )
+	{
+		payload.data()[ i ] = static_cast< bstream::byte_type >( i );
+	}
+
+	raft::frame::ptr frame = std::make_shared< raft::state_machine_update >( 7, 1234567, payload.slice( 0, payload.size() ) );
+	frame->file_position( 98765 );
+
+	run( type, "bstream",
+		[&] () { return bstream_encode( frame, raft::get_log_context() ); },
+		[] ( buffer const& buf ) { return bstream_decode< raft::frame::ptr >( buf, raft::get_log_context() ); } );
+
+	// the other codecs have no notion of the frame classes, so they carry the equivalent fields
+
+	auto const& update = frame->as< raft::state_machine_update >();
+	auto update_payload = update.payload();
+
+	run( type, "msgpack-c",
+		[&] ()
+		{
+			::msgpack::sbuffer sbuf;
+			::msgpack::packer< ::msgpack::sbuffer > packer{ sbuf };
+			packer.pack_array( 4 );
+			packer.pack( update.file_position() );
+			packer.pack( update.term() );
+			packer.pack( update.index() );
+			packer.pack_bin( static_cast< std::uint32_t >( update_payload.size() ) );
+			packer.pack_bin_body( reinterpret_cast< const char* >( update_payload.data() ), static_cast< std::uint32_t >( update_payload.size() ) );
+			return sbuf;
+		},
+		[] ( ::msgpack::sbuffer const& sbuf )
+		{
+			auto handle = ::msgpack::unpack( sbuf.data(), sbuf.size() );
+			auto const& arr = handle.get().via.array;
+			auto const& bin = arr.ptr[ 3 ].via.bin;
+			auto result = std::make_shared< raft::state_machine_update >( arr.ptr[ 1 ].as< raft::term_type >(), arr.ptr[ 2 ].as< raft::index_type >(), buffer{ bin.ptr, bin.size } );
+			result->file_position( arr.ptr[ 0 ].as< raft::file_position_type >() );
+			return result;
+		} );
+
+	any root;
+	root[ "pos" ] = update.file_position();
+	root[ "term" ] = update.term();
+	root[ "index" ] = update.index();
+	root[ "payload" ] = update_payload;
+	run_any_codecs( type, root );
+}
+
+/*
+ * nested string-keyed maps, 16 x 16
+ */
+
+void
+bench_nested_maps()
+{
+	std::string type{ "nested_maps" };
+	using map_type = std::map< std::string, std::map< std::string, std::int64_t > >;
+
+	map_type value;
+	any root;
+	for ( auto i = 0; i < 16; ++i )
+	{
+		auto outer = "section_" + std::to_string( i );
+		for ( auto j = 0; j < 16; ++j )
+		{
+			auto inner = "key_" + std::to_string( j );
+			value[ outer ][ inner ] = i * 1000 + j;
+			root[ outer ][ inner ] = i * 1000 + j;
+		}
+	}
+
+	run( type, "bstream",
+		[&] () { return bstream_encode( value ); },
+		[] ( buffer const& buf ) { return bstream_decode< map_type >( buf ); } );
+
+	run( type, "msgpack-c",
+		[&] () { return msgpack_encode( value ); },
+		[] ( ::msgpack::sbuffer const& sbuf ) { return msgpack_decode< map_type >( sbuf ); } );
+
+	run_any_codecs( type, root );
+}
+
+/*
+ * numeric vector, 1024 doubles
+ */
+
+void
+bench_numeric_vector()
+{
+	std::string type{ "vector<double>" };
+
+	std::vector< double > value;
+	for ( auto i = 0; i < 1024; ++i )
+	{
+		value.push_back( i * 0.5 );
+	}
+
+	run( type, "bstream",
+		[&] () { return bstream_encode( value ); },
+		[] ( buffer const& buf ) { return bstream_decode< std::vector< double > >( buf ); } );
+
+	run( type, "bstream-bulk",
+		[&] ()
+		{
+			bstream::ombstream os{ 16384 };
+			os.write_num_array( value );
+			return os.get_buffer();
+		},
+		[] ( buffer const& buf )
+		{
+			bstream::imbstream is{ buf };
+			std::vector< double > result;
+			is.read_num_array( result );
+			return result;
+		} );
+
+	run( type, "msgpack-c",
+		[&] () { return msgpack_encode( value ); },
+		[] ( ::msgpack::sbuffer const& sbuf ) { return msgpack_decode< std::vector< double > >( sbuf ); } );
+
+	run_any_codecs( type, any{ value } );
+}
+
+/*
+ * raw numbers, 1024 uint64 through numstream, with the stream's runtime
+ * byte order and with the order fixed at compile time
+ */
+
+void
+bench_byte_order()
+{
+	std::string type{ "put_num/get_num" };
+	bstream::context<> cntxt{ true, boost::endian::order::big };
+
+	run( type, "runtime-order",
+		[&] ()
+		{
+			bstream::ombstream os{ 8192, cntxt };
+			for ( std::uint64_t i = 0; i < 1024; ++i )
+			{
+				os.put_num( i * 0x10001 );
+			}
+			return os.get_buffer();
+		},
+		[&] ( buffer const& buf )
+		{
+			bstream::imbstream is{ buf, cntxt };
+			std::uint64_t sum = 0;
+			for ( auto i = 0; i < 1024; ++i )
+			{
+				sum += is.get_num< std::uint64_t >();
+			}
+			return sum;
+		} );
+
+	run( type, "fixed-order",
+		[&] ()
+		{
+			bstream::ombstream os{ 8192, cntxt };
+			for ( std::uint64_t i = 0; i < 1024; ++i )
+			{
+				os.put_num< boost::endian::order::big >( i * 0x10001 );
+			}
+			return os.get_buffer();
+		},
+		[&] ( buffer const& buf )
+		{
+			bstream::imbstream is{ buf, cntxt };
+			std::uint64_t sum = 0;
+			for ( auto i = 0; i < 1024; ++i )
+			{
+				sum += is.get_num< std::uint64_t, boost::endian::order::big >();
+			}
+			return sum;
+		} );
+}
+
+/*
+ * strings, 256 of 32 characters
+ */
+
+void
+bench_strings()
+{
+	std::string type{ "vector<string>" };
+
+	std::vector< std::string > value;
+	for ( auto i = 0; i < 256; ++i )
+	{
+		auto s = "string value number " + std::to_string( i );
+		s.resize( 32, '.' );
+		value.push_back( s );
+	}
+
+	run( type, "bstream",
+		[&] () { return bstream_encode( value ); },
+		[] ( buffer const& buf ) { return bstream_decode< std::vector< std::string > >( buf ); } );
+
+	run( type, "msgpack-c",
+		[&] () { return msgpack_encode( value ); },
+		[] ( ::msgpack::sbuffer const& sbuf ) { return msgpack_decode< std::vector< std::string > >( sbuf ); } );
+
+	run_any_codecs( type, any{ value } );
+}
+
+/*
+ * heterogeneous any tree, shaped like an rpc message; only the any-based
+ * codecs apply
+ */
+
+void
+bench_any_tree()
+{
+	any root;
+	root[ "jsonrpc" ] = "2.0";
+	root[ "method" ] = "/conductor/repeater/update_objects";
+	root[ "id" ] = 42;
+	auto& params = root[ "params" ];
+	for ( auto i = 0; i < 32; ++i )
+	{
+		any item;
+		item[ "oid" ] = i;
+		item[ "table" ] = "service";
+		item[ "enabled" ] = ( i % 2 ) == 0;
+		item[ "location" ][ "latitude" ] = 37.449582 + i;
+		item[ "location" ][ "longitude" ] = -122.179963 - i;
+		params.push_back( item );
+	}
+
+	run_any_codecs( "any_tree", root );
+}
+
+} // anonymous namespace
+
+int
+main( int argc, char** argv )
+{
+	if ( argc > 1 )
+	{
+		g_filter = argv[ 1 ];
+	}
+
+	if ( argc > 2 )
+	{
+		g_min_time = std::chrono::milliseconds{ std::atol( argv[ 2 ] ) };
+	}
+
+	print_header();
+	bench_raft_frame();
+	bench_nested_maps();
+	bench_numeric_vector();
+	bench_byte_order();
+	bench_strings();
+	bench_any_tree();
+
+	return 0;
+}
@@ -0,0 +1,226 @@
+#ifndef NODEOZE_BSTREAM_BVIEW_H
+#define NODEOZE_BSTREAM_BVIEW_H
+
+#include <nodeoze/bstream/imbstream.h>
+#include <nodeoze/bstream/typecode.h>
+#include <nodeoze/bstream/error.h>
+#include <string_view>
+
+namespace nodeoze
+{
+namespace bstream
+{
+
+/*
+ * A read-only, lazily evaluated view of one encoded value in a buffer.
+ * Navigating into arrays and maps walks the typecode structure, skipping
+ * over values without decoding them; only the value finally requested
+ * with as< T >() is deserialized. Views share the underlying buffer, so
+ * they remain valid independent of the buffer they were created from.
+ *
+ * The context supplies the byte order used to interpret lengths, and is
+ * used for as< T >().
+ */
+
+class bview
+{
+public:
+
+    enum class kind
+    {
+        invalid,
+        nil,
+        boolean,
+        integer,
+        floating,
+        string,
+        blob,
+        array,
+        map,
+        ext,
+    };
+
+    bview()
+    :
+    m_buf{},
+    m_begin{ 0 },
+    m_end{ 0 },
+    m_context{ nullptr }
+    {}
+
+    bview( buffer const& buf, context_base const& cntxt = get_default_context() )
+    :
+    m_buf{ buf },
+    m_begin{ 0 },
+    m_end{ buf.size() },
+    m_context{ cntxt.get_context_impl() }
+    {}
+
+    bool
+    is_valid() const noexcept
+    {
+        return m_context != nullptr && m_begin < m_end;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return is_valid();
+    }
+
+    kind
+    get_kind() const noexcept;
+
+    /*
+     * Element count for arrays and maps, byte count for strings, blobs
+     * and ext payloads, zero otherwise.
+     */
+
+    std::size_t
+    size( std::error_code& err ) const;
+
+    std::size_t
+    size() const;
+
+    bview
+    at( std::size_t index, std::error_code& err ) const;
+
+    bview
+    at( std::size_t index ) const;
+
+    bview
+    operator[]( std::size_t index ) const
+    {
+        return at( index );
+    }
+
+    /*
+     * Returns the value associated with a string key in a map, or an
+     * invalid view if the key is not present.
+     */
+
+    bview
+    find( std::string_view key, std::error_code& err ) const;
+
+    bview
+    find( std::string_view key ) const;
+
+    bview
+    operator[]( std::string_view key ) const
+    {
+        return find( key );
+    }
+
+    /*
+     * String and blob payloads, aliasing the underlying buffer.
+     */
+
+    std::string_view
+    string_view( std::error_code& err ) const;
+
+    std::string_view
+    string_view() const;
+
+    buffer
+    blob( std::error_code& err ) const;
+
+    buffer
+    blob() const;
+
+    /*
+     * The encoded bytes of this value (and only this value).
+     */
+
+    buffer
+    encoded( std::error_code& err ) const;
+
+    buffer
+    encoded() const;
+
+    template< class T >
+    T
+    as() const
+    {
+        if ( ! is_valid() )
+        {
+            throw std::system_error{ make_error_code( bstream::errc::invalid_state ) };
+        }
+        context_ref cntxt{ m_context };
+        imbstream is{ m_buf.slice( m_begin, m_end - m_begin ), cntxt };
+        return is.read_as< T >();
+    }
+
+    template< class T >
+    T
+    as( std::error_code& err ) const
+    {
+        clear_error( err );
+        try
+        {
+            return as< T >();
+        }
+        catch ( std::system_error const& e )
+        {
+            err = e.code();
+        }
+        return T{};
+    }
+
+private:
+
+    class context_ref : public context_base
+    {
+    public:
+
+        context_ref( std::shared_ptr< const context_impl_base > const& impl )
+        :
+        m_impl{ impl }
+        {}
+
+        virtual std::shared_ptr< const context_impl_base >
+        get_context_impl() const override
+        {
+            return m_impl;
+        }
+
+    private:
+
+        std::shared_ptr< const context_impl_base > m_impl;
+    };
+
+    struct header
+    {
+        kind            k;
+        std::size_t     header_size;
+        std::size_t     count;          // elements for arrays/maps, payload bytes otherwise
+    };
+
+    bview( buffer const& buf, std::size_t begin, std::size_t end, std::shared_ptr< const context_impl_base > const& cntxt )
+    :
+    m_buf{ buf },
+    m_begin{ begin },
+    m_end{ end },
+    m_context{ cntxt }
+    {}
+
+    bool
+    reverse_order() const noexcept
+    {
+        return m_context->byte_order() != bend::order::native;
+    }
+
+    header
+    read_header( std::size_t pos, std::error_code& err ) const;
+
+    std::size_t
+    skip( std::size_t pos, std::error_code& err ) const;
+
+    buffer                                          m_buf;
+    std::size_t                                     m_begin;
+    std::size_t                                     m_end;
+    std::shared_ptr< const context_impl_base >      m_context;
+};
+
+} // namespace bstream
+} // namespace nodeoze
+
+#endif // NODEOZE_BSTREAM_BVIEW_H
@@ -8,6 +8,10 @@
 #include <nodeoze/bstream/utils/traits.h>
 #include <nodeoze/bstream/ibstream_traits.h>
 #include <typeindex>
+#include <typeinfo>
+#include <array>
+#include <memory>
+#include <functional>
 
 namespace nodeoze
 {
@@ -21,24 +25,77 @@ class context_impl_base : public error_category_context
 public:
     static constexpr bool is_valid_tag( poly_tag_type tag ) { return tag != invalid_tag; };
 
-    context_impl_base( bool dedup_shared_ptrs, boost::endian::order byte_order )
+    context_impl_base(  bool dedup_shared_ptrs, 
+                        boost::endian::order byte_order,
+                        std::type_info const* const* type_infos,
+                        std::size_t type_count,
+                        std::uint64_t const* downcast_bits )
     :
     error_category_context{},
     m_dedup_shared_ptrs{ dedup_shared_ptrs },
-    m_byte_order{ byte_order }
+    m_byte_order{ byte_order },
+    m_type_infos{ type_infos },
+    m_type_count{ type_count },
+    m_downcast_bits{ downcast_bits }
     {}
 
-    context_impl_base( error_category_context::category_init_list categories, bool dedup_shared_ptrs, boost::endian::order byte_order )
+    context_impl_base(  error_category_context::category_init_list categories, 
+                        bool dedup_shared_ptrs, 
+                        boost::endian::order byte_order,
+                        std::type_info const* const* type_infos,
+                        std::size_t type_count,
+                        std::uint64_t const* downcast_bits )
     :
     error_category_context{ categories },
     m_dedup_shared_ptrs{ dedup_shared_ptrs },
-    m_byte_order{ byte_order }
+    m_byte_order{ byte_order },
+    m_type_infos{ type_infos },
+    m_type_count{ type_count },
+    m_downcast_bits{ downcast_bits }
     {}
 
     virtual ~context_impl_base() {}
 
-    virtual poly_tag_type
-    get_type_tag( std::type_index index ) const = 0;
+    /*
+     *  Type tags are looked up in a flat table of type_info addresses, 
+     *  in the order of the context's template parameters. The first pass 
+     *  compares addresses only, which finds the tag for any type whose 
+     *  type_info was emitted in this image; the second pass falls back to
+     *  type_info equality for types that cross shared library boundaries.
+     */
+
+    poly_tag_type
+    get_type_tag( std::type_info const& info ) const
+    {
+        for ( std::size_t i = 0; i < m_type_count; ++i )
+        {
+            if ( m_type_infos[ i ] == &info )
+            {
+                return static_cast< poly_tag_type >( i );
+            }
+        }
+        for ( std::size_t i = 0; i < m_type_count; ++i )
+        {
+            if ( *m_type_infos[ i ] == info )
+            {
+                return static_cast< poly_tag_type >( i );
+            }
+        }
+        return invalid_tag;
+    }
+
+    poly_tag_type
+    get_type_tag( std::type_index index ) const
+    {
+        for ( std::size_t i = 0; i < m_type_count; ++i )
+        {
+            if ( std::type_index{ *m_type_infos[ i ] } == index )
+            {
+                return static_cast< poly_tag_type >( i );
+            }
+        }
+        return invalid_tag;
+    }
 
     template< class T >
     poly_tag_type
@@ -47,8 +104,35 @@ public:
         return get_type_tag( typeid( T ) );
     }
 
-    virtual bool
-    can_downcast_ptr( poly_tag_type from, poly_tag_type to ) const = 0;
+    /*
+     *  Tag for the dynamic type of obj. If the static type can't have 
+     *  a more-derived dynamic type, the typeid of the static type is 
+     *  used and no run-time type lookup is made.
+     */
+    template< class T >
+    poly_tag_type
+    get_dynamic_type_tag( T const& obj ) const
+    {
+        if constexpr ( ! std::is_polymorphic< T >::value || std::is_final< T >::value )
+        {
+            return get_type_tag< T >();
+        }
+        else
+        {
+            return get_type_tag( typeid( obj ) );
+        }
+    }
+
+    bool
+    can_downcast_ptr( poly_tag_type from, poly_tag_type to ) const
+    {
+        if ( from < 0 || to < 0 || static_cast< std::size_t >( from ) >= m_type_count || static_cast< std::size_t >( to ) >= m_type_count )
+        {
+            return false;
+        }
+        auto bit = static_cast< std::size_t >( from ) * m_type_count + static_cast< std::size_t >( to );
+        return ( m_downcast_bits[ bit / 64 ] & ( std::uint64_t{ 1 } << ( bit % 64 ) ) ) != 0;
+    }
 
     virtual void*
     create_raw_from_tag( poly_tag_type tag, ibstream& is ) const = 0;
@@ -99,6 +183,9 @@ public:
 private:
     bool                        m_dedup_shared_ptrs;
     boost::endian::order        m_byte_order;
+    std::type_info const* const* m_type_infos;
+    std::size_t                 m_type_count;
+    std::uint64_t const*        m_downcast_bits;
 };
 
 using poly_raw_factory_func = std::function< void* ( ibstream& ) >;
@@ -111,27 +198,82 @@ struct can_downcast_ptr : public std::false_type {};
 template< class T1, class T2 >
 struct can_downcast_ptr< T1, T2, std::enable_if_t< std::is_base_of< T2, T1 >::value > > : public std::true_type {};
 
-template< class T, class... Args >
-struct can_downcast_ptr_row
+namespace detail
+{
+
+template< class... Args >
+struct downcast_bits
 {
-    static const std::vector< bool > row_values;
+    static constexpr std::size_t size = sizeof...( Args );
+    static constexpr std::size_t word_count = ( size * size + 63 ) / 64 + 1;
+
+    using type = std::array< std::uint64_t, word_count >;
+
+    static constexpr void
+    set_bit( type& bits, std::size_t bit, bool value )
+    {
+        if ( value )
+        {
+            bits[ bit / 64 ] |= std::uint64_t{ 1 } << ( bit % 64 );
+        }
+    }
+
+    template< class From >
+    static constexpr void
+    set_row( type& bits, std::size_t row )
+    {
+        std::size_t col = 0;
+        ( set_bit( bits, row * size + col++, can_downcast_ptr< From, Args >::value ), ... );
+    }
+
+    static constexpr type
+    make()
+    {
+        type bits{};
+        std::size_t row = 0;
+        ( set_row< Args >( bits, row++ ), ... );
+        return bits;
+    }
 };
 
-template< class T, class... Args >
-const std::vector< bool > can_downcast_ptr_row< T, Args... >::row_values = { can_downcast_ptr< T, Args >::value... };
+} // namespace detail
 
+/*
+ *  Bit ( from * size + to ) is set if a pointer to the type with tag 'from'
+ *  can be cast to a pointer to the type with tag 'to'.
+ */
 template< class... Args >
 struct can_downcast_ptr_table
 {
-    static const std::vector< std::vector< bool > > values;
-};
+    static constexpr std::size_t size = sizeof...( Args );
 
-template< class... Args >
-const std::vector< std::vector< bool > > can_downcast_ptr_table< Args... >::values = 
-{ 
-    { can_downcast_ptr_row< Args, Args... >::row_values }... 
+    static constexpr typename detail::downcast_bits< Args... >::type values = detail::downcast_bits< Args... >::make();
+
+    static constexpr bool
+    test( poly_tag_type from, poly_tag_type to )
+    {
+        return ( from >= 0 && to >= 0 && static_cast< std::size_t >( from ) < size && static_cast< std::size_t >( to ) < size ) 
+            ? ( values[ ( from * size + to ) / 64 ] & ( std::uint64_t{ 1 } << ( ( from * size + to ) % 64 ) ) ) != 0 
+            : false;
+    }
 };
 
+namespace detail
+{
+
+template< class T, class... Args >
+struct type_tag_of : public std::integral_constant< poly_tag_type, invalid_tag > {};
+
+template< class T, class... Args >
+struct type_tag_of< T, T, Args... > : public std::integral_constant< poly_tag_type, 0 > {};
+
+template< class T, class U, class... Args >
+struct type_tag_of< T, U, Args... > 
+: public std::integral_constant< poly_tag_type, 
+    ( type_tag_of< T, Args... >::value == invalid_tag ) ? invalid_tag : 1 + type_tag_of< T, Args... >::value > {};
+
+} // namespace detail
+
 template< class... Args >
 class context_impl : public context_impl_base
 {
@@ -139,32 +281,23 @@ public:
 
     context_impl( bool dedup_shared_ptrs, boost::endian::order byte_order )
     :
-    context_impl_base{ dedup_shared_ptrs, byte_order }
+    context_impl_base{ dedup_shared_ptrs, byte_order, m_type_infos.data(), sizeof...( Args ), m_downcast_ptr_table.values.data() }
     {}
 
     context_impl( error_category_context::category_init_list categories, bool dedup_shared_ptrs, boost::endian::order byte_order )
     :
-    context_impl_base{ categories, dedup_shared_ptrs, byte_order }
+    context_impl_base{ categories, dedup_shared_ptrs, byte_order, m_type_infos.data(), sizeof...( Args ), m_downcast_ptr_table.values.data() }
     {}
 
-    virtual poly_tag_type 
-    get_type_tag( std::type_index index ) const override
-    {
-        auto it = m_type_tag_map.find( index );
-        if ( it != m_type_tag_map.end() )
-        {
-            return it->second;
-        }
-        else
-        {
-            return invalid_tag;
-        }
-    }
-
-    virtual bool 
-    can_downcast_ptr( poly_tag_type from, poly_tag_type to ) const override
+    /*
+     *  Tag for a static type, resolved at compile time; 
+     *  invalid_tag if T is not one of Args...
+     */
+    template< class T >
+    static constexpr poly_tag_type
+    type_tag()
     {
-        return m_downcast_ptr_table.values[ from ][ to ];
+        return detail::type_tag_of< T, Args... >::value;
     }
 
     virtual void*
@@ -180,21 +313,12 @@ public:
     }
 
 protected:
-    static const std::unordered_map< std::type_index, poly_tag_type >   m_type_tag_map;
-    static const can_downcast_ptr_table< Args... >                      m_downcast_ptr_table;
-    static const std::vector< poly_raw_factory_func >                   m_factories;
-    static const std::vector< poly_shared_factory_func >                m_shared_factories;
+    static constexpr std::array< std::type_info const*, sizeof...( Args ) > m_type_infos{ { &typeid( Args )... } };
+    static constexpr can_downcast_ptr_table< Args... >                      m_downcast_ptr_table{};
+    static const std::array< void* (*)( ibstream& ), sizeof...( Args ) >                    m_factories;
+    static const std::array< std::shared_ptr< void > (*)( ibstream& ), sizeof...( Args ) >  m_shared_factories;
 };
 
-template< class... Args >
-const std::unordered_map< std::type_index, poly_tag_type > context_impl< Args... >::m_type_tag_map = 
-{ 
-    { typeid( Args ), utils::index< Args, Args... >::value }... 
-};
-
-template< class... Args >
-const can_downcast_ptr_table< Args... > context_impl< Args... >::m_downcast_ptr_table;
-
 template< class T, class Enable = void >
 struct poly_factory;
 
@@ -231,12 +355,9 @@ struct poly_factory< T, std::enable_if_t< ! std::is_abstract< T >::value && has_
 };
 
 template< class... Args >
-const std::vector< poly_raw_factory_func > context_impl< Args... >::m_factories = 
-{
-    []( ibstream& is ) 
-    {
-        return poly_factory< Args >::get( is );
-    }...
+const std::array< void* (*)( ibstream& ), sizeof...( Args ) > context_impl< Args... >::m_factories = 
+{ 
+    { &poly_factory< Args >::get... } 
 };
 
 template< class T, class Enable = void >
@@ -275,12 +396,9 @@ struct poly_shared_factory< T, std::enable_if_t< ! std::is_abstract< T >::value
 };
 
 template< class... Args >
-const std::vector< poly_shared_factory_func > context_impl< Args... >::m_shared_factories =
-{
-    [] ( ibstream& is )
-    {
-        return poly_shared_factory< Args >::get( is );
-    }...
+const std::array< std::shared_ptr< void > (*)( ibstream& ), sizeof...( Args ) > context_impl< Args... >::m_shared_factories =
+{ 
+    { &poly_shared_factory< Args >::get... } 
 };
 
 class context_base 
@@ -308,6 +426,13 @@ public:
     :
     m_context_impl{ std::make_shared< const context_impl< Args... > >( categories, dedup_shared_ptrs, byte_order ) }
     {}
+
+    template< class T >
+    static constexpr poly_tag_type
+    type_tag()
+    {
+        return context_impl< Args... >::template type_tag< T >();
+    }
     
     virtual std::shared_ptr< const context_impl_base >
     get_context_impl() const override
@@ -0,0 +1,83 @@
+#ifndef NODEOZE_BSTREAM_IBCOMPRESSBUF_H
+#define NODEOZE_BSTREAM_IBCOMPRESSBUF_H
+
+#include <nodeoze/bstream/ibstreambuf.h>
+#include <nodeoze/bstream/error.h>
+#include <memory>
+#include <vector>
+
+#ifndef NODEOZE_BSTREAM_DEFAULT_IBCOMPRESSBUF_SIZE
+#define NODEOZE_BSTREAM_DEFAULT_IBCOMPRESSBUF_SIZE  16384UL
+#endif
+
+namespace nodeoze 
+{
+namespace bstream 
+{
+
+/*
+ * The counterpart of obcompressbuf: reads a deflated (zlib format) stream from
+ * another stream buffer and inflates it a buffer at a time as the get area
+ * underflows. The end of the compressed stream is reported as end of input.
+ * Seeking is limited to the currently decompressed buffer.
+ */
+
+class ibcompressbuf : public ibstreambuf
+{
+public:
+
+    ibcompressbuf( std::unique_ptr< ibstreambuf > source, std::error_code& err,
+            size_type buffer_size = NODEOZE_BSTREAM_DEFAULT_IBCOMPRESSBUF_SIZE );
+
+    ibcompressbuf( std::unique_ptr< ibstreambuf > source,
+            size_type buffer_size = NODEOZE_BSTREAM_DEFAULT_IBCOMPRESSBUF_SIZE );
+
+    ibcompressbuf( ibcompressbuf&& ) = delete;
+    ibcompressbuf( ibcompressbuf const& ) = delete;
+    ibcompressbuf& operator=( ibcompressbuf&& ) = delete;
+    ibcompressbuf& operator=( ibcompressbuf const& ) = delete;
+
+    virtual ~ibcompressbuf();
+
+    ibstreambuf&
+    source() noexcept
+    {
+        return *m_source;
+    }
+
+protected:
+
+    virtual position_type
+    really_seek( seek_anchor where, offset_type offset, std::error_code& err ) override;
+
+    virtual position_type
+    really_tell( seek_anchor where, std::error_code& err ) override;
+
+    virtual size_type
+    really_underflow( std::error_code& err ) override;
+
+private:
+
+    struct zstate;
+
+    void
+    init( std::error_code& err );
+
+    void
+    reset_ptrs()
+    {
+        auto base = m_data.data();
+        set_ptrs( base, base, base );
+    }
+
+    std::unique_ptr< ibstreambuf >  m_source;
+    std::vector< byte_type >        m_data;
+    std::vector< byte_type >        m_zdata;
+    std::unique_ptr< zstate >       m_zstate;
+    bool                            m_at_end;
+};
+
+} // namespace bstream
+} // namespace nodeoze
+
+#endif // NODEOZE_BSTREAM_IBCOMPRESSBUF_H
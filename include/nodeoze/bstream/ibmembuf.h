@@ -13,6 +13,7 @@ class ibmembuf : public ibstreambuf
 public:
 
     using ibstreambuf::getn;
+    using ibstreambuf::get_slice;
 
     ibmembuf( buffer const& buf, buffer::policy pol = buffer::policy::copy_on_write )
     :
@@ -42,9 +43,6 @@ public:
 		return m_buf;
 	}
 
-    buffer
-    get_slice( size_type n );
-
     virtual buffer
     getn( size_type n, std::error_code& err ) override;
 
@@ -53,6 +51,12 @@ public:
 
 protected:
 
+    virtual buffer
+    really_get_slice( size_type n, std::error_code& err ) override;
+
+    buffer
+    slice_available( size_type n );
+
     ibmembuf( size_type size, buffer::policy pol = buffer::policy::copy_on_write )
     :
     ibstreambuf{},
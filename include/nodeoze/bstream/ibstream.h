@@ -36,7 +36,8 @@
 #include <nodeoze/bstream/numeric_deserializers.h>
 #include <nodeoze/bstream/context.h>
 #include <nodeoze/bstream/numstream.h>
-#include <deque>
+#include <nodeoze/bstream/utils/memory.h>
+#include <vector>
 
 namespace nodeoze
 {
@@ -66,28 +67,39 @@ public:
     {
     public:
 
+        ptr_deduper()
+        {
+            m_saved_ptrs.reserve( initial_capacity );
+        }
+
         template< class T >
         void
         save_ptr( std::shared_ptr< T > ptr )
         {
-            m_saved_ptrs.push_back( saved_ptr_info( typeid( *ptr ), ptr ) );
+            m_saved_ptrs.emplace_back( typeid( *ptr ), std::move( ptr ) );
         }
 
         saved_ptr_info const&
         get_saved_ptr( std::size_t index )
         {
+            if ( index >= m_saved_ptrs.size() )
+            {
+                throw std::system_error{ make_error_code( bstream::errc::invalid_state ) };
+            }
             return m_saved_ptrs[ index ];
         }
 
         void
         clear()
         {
-            m_saved_ptrs.clear();
+            m_saved_ptrs.clear();   // retains capacity
         }
 
     private:
 
-        std::deque< saved_ptr_info >        m_saved_ptrs;
+        static constexpr std::size_t initial_capacity = 64;
+
+        std::vector< saved_ptr_info >       m_saved_ptrs;
     };
 
 
@@ -330,6 +342,66 @@ public:
     nodeoze::buffer
     read_blob( std::error_code& ec );
 
+    /*
+     * The view readers return data that aliases the underlying stream
+     * buffer rather than a copy; they fail with errc::ibstreambuf_not_shareable
+     * if the stream buffer cannot share its storage (e.g., file buffers).
+     * The result remains valid for as long as the returned buffer (or
+     * string_alias) is held, independent of the stream's lifetime.
+     */
+
+    nodeoze::buffer
+    read_blob_view()
+    {
+        auto nbytes = read_blob_header();
+        return get_slice( nbytes );
+    }
+
+    nodeoze::buffer
+    read_blob_view( std::error_code& ec );
+
+    nodeoze::string_alias
+    read_string_view()
+    {
+        auto nbytes = read_string_header();
+        return nodeoze::string_alias{ get_slice( nbytes ) };
+    }
+
+    nodeoze::string_alias
+    read_string_view( std::error_code& ec );
+
+    template< class U, class Alloc >
+    typename std::enable_if_t< detail::is_bulk_num< U >::value, ibstream& >
+    read_num_array( std::vector< U, Alloc >& vec )
+    {
+        auto nbytes = read_blob_header();
+        if ( nbytes % sizeof( U ) != 0 )
+        {
+            throw std::system_error{ make_error_code( bstream::errc::type_error ) };
+        }
+        get_nums( vec, nbytes / sizeof( U ) );
+        return *this;
+    }
+
+    template< class U, class Alloc >
+    typename std::enable_if_t< detail::is_bulk_num< U >::value, ibstream& >
+    read_num_array( std::vector< U, Alloc >& vec, std::error_code& ec )
+    {
+        auto nbytes = read_blob_header( ec );
+        if ( ec ) goto exit;
+
+        if ( nbytes % sizeof( U ) != 0 )
+        {
+            ec = make_error_code( bstream::errc::type_error );
+            goto exit;
+        }
+
+        get_nums( vec, nbytes / sizeof( U ), ec );
+
+    exit:
+        return *this;
+    }
+
     std::size_t
     read_ext_header( std::uint8_t& ext_type );
 
@@ -395,6 +467,31 @@ public:
     //     position( 0, err );
     // }
 
+#if NODEOZE_BSTREAM_USE_PMR
+
+    /*
+     *  If a memory resource is set, objects created by deserialization
+     *  (shared pointers and stdlib containers with a polymorphic_allocator)
+     *  are allocated from it. With a monotonic arena per message, the
+     *  caller must release every deserialized object before resetting
+     *  the arena. The resource is not owned by the stream.
+     */
+
+    std::pmr::memory_resource*
+    memory_resource() const noexcept
+    {
+        return m_memory_resource;
+    }
+
+    ibstream&
+    memory_resource( std::pmr::memory_resource* mr ) noexcept
+    {
+        m_memory_resource = mr;
+        return *this;
+    }
+
+#endif
+
     buffer
     get_msgpack_obj_buf();
 
@@ -572,7 +669,7 @@ protected:
         if ( m_ptr_deduper )
         {
             auto index = read_as< std::size_t >();
-            auto info = m_ptr_deduper->get_saved_ptr( index );
+            auto const& info = m_ptr_deduper->get_saved_ptr( index );
             if ( type_tag > -1 )
             {
                 auto saved_tag = m_context->get_type_tag( info.first );
@@ -580,7 +677,7 @@ protected:
                 {
                     throw std::system_error{ make_error_code( bstream::errc::type_error ) };
                 }
-                if ( m_context->can_downcast_ptr( type_tag, m_context->get_type_tag( typeid( T ) ) ) )
+                if ( m_context->can_downcast_ptr( type_tag, m_context->get_type_tag< T >() ) )
                 {
                     result = std::static_pointer_cast< T >( info.second );
                 }
@@ -618,6 +715,65 @@ protected:
     std::unique_ptr< bufwriter >                    m_bufwriter = nullptr;
     std::shared_ptr< const context_impl_base >      m_context;
     std::unique_ptr< ptr_deduper >                  m_ptr_deduper;
+#if NODEOZE_BSTREAM_USE_PMR
+    std::pmr::memory_resource*                      m_memory_resource = nullptr;
+#endif
+};
+
+/*
+ *  Allocator and shared pointer construction for deserialized objects,
+ *  honoring the stream's memory resource where the allocator type can 
+ *  use one.
+ */
+
+template< class Alloc >
+inline Alloc
+stream_allocator( ibstream& is )
+{
+#if NODEOZE_BSTREAM_USE_PMR
+    if constexpr ( std::is_constructible< Alloc, std::pmr::memory_resource* >::value )
+    {
+        if ( is.memory_resource() )
+        {
+            return Alloc{ is.memory_resource() };
+        }
+    }
+#endif
+    return Alloc{};
+}
+
+template< class T, class... Args >
+inline std::shared_ptr< T >
+make_stream_shared( ibstream& is, Args&&... args )
+{
+#if NODEOZE_BSTREAM_USE_PMR
+    if ( is.memory_resource() )
+    {
+        return std::allocate_shared< T >( std::pmr::polymorphic_allocator< T >{ is.memory_resource() }, std::forward< Args >( args )... );
+    }
+#endif
+    return std::make_shared< T >( std::forward< Args >( args )... );
+}
+
+template< class Traits, class Alloc >
+struct value_deserializer< std::basic_string< char, Traits, Alloc >, 
+    std::enable_if_t< ! std::is_same< Alloc, std::allocator< char > >::value > >
+{
+    using string_type = std::basic_string< char, Traits, Alloc >;
+
+    string_type 
+    operator()( ibstream& is ) const
+    {
+        return get( is );
+    }
+
+    static string_type get( ibstream& is )
+    {
+        auto length = is.read_string_header();
+        string_type result( stream_allocator< Alloc >( is ) );
+        is.get_nums( result, length );
+        return result;
+    }
 };
 	        
 template< class T >
@@ -830,7 +986,7 @@ struct shared_ptr_deserializer< T, typename std::enable_if_t< is_ibstream_constr
     static std::shared_ptr< T >
     get( ibstream& is )
     {
-        return std::make_shared< T >( is );
+        return make_stream_shared< T >( is, is );
     }
 };
 
@@ -893,7 +1049,7 @@ struct shared_ptr_deserializer< T,
     static std::shared_ptr< T >
     get( ibstream& is )
     {
-        return std::make_shared< T >( value_deserializer< T >::get( is ) );
+        return make_stream_shared< T >( is, value_deserializer< T >::get( is ) );
     }
 };
 
@@ -963,7 +1119,7 @@ struct shared_ptr_deserializer< T,
     static std::shared_ptr< T >
     get( ibstream& is )
     {
-        std::shared_ptr< T > ptr = std::make_shared< T >();
+        std::shared_ptr< T > ptr = make_stream_shared< T >( is );
         ref_deserializer< T >::get( is, *ptr );
         return ptr;
     }
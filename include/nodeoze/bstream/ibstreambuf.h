@@ -64,6 +64,20 @@ public:
     size_type 
     getn( byte_type* dst, size_type n );
 
+    /**
+     * Returns a buffer that aliases the next n bytes of the stream's storage,
+     * advancing the read position by n. No bytes are copied. Derived classes
+     * that cannot share their storage report errc::ibstreambuf_not_shareable.
+     */
+    buffer
+    get_slice( size_type n, std::error_code& err )
+    {
+        return really_get_slice( n, err );
+    }
+
+    buffer
+    get_slice( size_type n );
+
     position_type
     seek( position_type position, std::error_code& err )
     {
@@ -188,6 +202,9 @@ protected:
     virtual size_type
     really_underflow( std::error_code& err );
 
+    virtual buffer
+    really_get_slice( size_type n, std::error_code& err );
+
     position_type               m_gbase_offset;
     byte_type*                  m_gbase;
     byte_type*                  m_gnext;
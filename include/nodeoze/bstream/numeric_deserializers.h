@@ -4,6 +4,7 @@
 #include <nodeoze/bstream/ibstream_traits.h>
 
 #include <cstdint>
+#include <string_view>
 #include <nodeoze/bstream/error.h>
 #include <nodeoze/bstream/typecode.h>
 #include <nodeoze/bstream/numstream.h>
@@ -406,6 +407,13 @@ struct value_deserializer< std::string >
         return get( is );
     }
 
+    static std::string get( inumstream& is, std::size_t length )
+    {
+        std::string result;
+        is.get_nums( result, length );
+        return result;
+    }
+
     static std::string get( inumstream& is )
     {
         auto tcode = is.get();
@@ -413,7 +421,7 @@ struct value_deserializer< std::string >
         {
             std::uint8_t mask = 0x1f;
             std::size_t length = tcode & mask;
-            return is.getn( length ).to_string(); // TODO: does this work? construct string?
+            return get( is, length );
         }
         else
         {
@@ -422,17 +430,17 @@ struct value_deserializer< std::string >
                 case typecode::str_8:
                 {
                     std::size_t length = is.get_num< std::uint8_t >();
-                    return is.getn( length ).to_string();
+                    return get( is, length );
                 }
                 case typecode::str_16:
                 {
                     std::size_t length = is.get_num< std::uint16_t >();
-                    return is.getn( length ).to_string();
+                    return get( is, length );
                 }
                 case typecode::str_32:
                 {
                     std::size_t length = is.get_num< std::uint32_t >();
-                    return is.getn( length ).to_string();
+                    return get( is, length );
                 }
                 default:
                     throw std::system_error{ make_error_code( bstream::errc::type_error ) };
@@ -490,6 +498,63 @@ struct value_deserializer< nodeoze::string_alias >
     }
 };
 
+/*
+ * A deserialized std::string_view aliases the stream buffer's storage; it is
+ * valid only while that storage is alive (i.e., while the stream, or the
+ * buffer it was constructed from, is alive). Streams whose buffers cannot
+ * share storage fail with errc::ibstreambuf_not_shareable.
+ */
+
+template<>
+struct value_deserializer< std::string_view >
+{
+    std::string_view 
+    operator()( inumstream& is ) const
+    {
+        return get( is );
+    }
+
+    static std::string_view get( inumstream& is, std::size_t length )
+    {
+        auto slice = is.get_slice( length );
+        return std::string_view{ reinterpret_cast< const char* >( slice.data() ), slice.size() };
+    }
+
+    static std::string_view get( inumstream& is )
+    {
+        auto tcode = is.get();
+        if ( tcode >= typecode::fixstr_min && tcode <= typecode::fixstr_max )
+        {
+            std::uint8_t mask = 0x1f;
+            std::size_t length = tcode & mask;
+            return get( is, length );
+        }
+        else
+        {
+            switch( tcode )
+            {
+                case typecode::str_8:
+                {
+                    std::size_t length = is.get_num< std::uint8_t >();
+                    return get( is, length );
+                }
+                case typecode::str_16:
+                {
+                    std::size_t length = is.get_num< std::uint16_t >();
+                    return get( is, length );
+                }
+                case typecode::str_32:
+                {
+                    std::size_t length = is.get_num< std::uint32_t >();
+                    return get( is, length );
+                }
+                default:
+                    throw std::system_error{ make_error_code( bstream::errc::type_error ) };
+            }
+        }
+    }
+};
+
 } // namespace bstream
 } // namespace nodeoze
 
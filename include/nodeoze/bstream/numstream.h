@@ -73,6 +73,59 @@ struct canonical_type< 8 >
 	using type = std::uint64_t;
 };
 
+/*
+ * Byte order conversion with the order fixed at compile time; the
+ * conversion reduces to a bswap (or nothing) with no runtime test.
+ */
+
+static constexpr bend::order reverse_of_native = 
+	( bend::order::native == bend::order::little ) ? bend::order::big : bend::order::little;
+
+template< bend::order Order, class C >
+inline constexpr C
+to_order( C value ) noexcept
+{
+	if constexpr ( Order == bend::order::native || sizeof( C ) == 1 )
+	{
+		return value;
+	}
+	else
+	{
+		return bend::endian_reverse( value );
+	}
+}
+
+/*
+ * Bulk numeric transfers byte-swap through a small stack-resident chunk,
+ * so the swap loop operates on canonical unsigned types and can be
+ * vectorized by the compiler without aliasing the caller's storage.
+ */
+
+static constexpr std::size_t bulk_chunk_size = 512;
+
+/*
+ * Lengths read off the wire are untrusted, so containers sized by them
+ * grow at most this many bytes ahead of the data actually read.
+ */
+
+static constexpr std::size_t untrusted_chunk_size = 64 * 1024;
+
+template< class C >
+inline void
+reverse_nums( C* p, std::size_t count )
+{
+	for ( std::size_t i = 0; i < count; ++i )
+	{
+		p[ i ] = bend::endian_reverse( p[ i ] );
+	}
+}
+
+template< class U >
+struct is_bulk_num : public std::integral_constant< bool, 
+	std::is_arithmetic< U >::value && 
+	! std::is_same< U, bool >::value &&
+	( sizeof( U ) == 1 || sizeof( U ) == 2 || sizeof( U ) == 4 || sizeof( U ) == 8 ) > {};
+
 } // namespace detail
 
 class onumstream
@@ -166,28 +219,105 @@ public:
 		return put( static_cast< std::uint8_t >( value ), err );
 	}
 
+	/*
+	 * Writes value in the stream's byte order. The order comes from the
+	 * context at run time, so this tests it once per value; every
+	 * serializer writes its numbers through here.
+	 */
+
 	template< class U >
 	typename std::enable_if< std::is_arithmetic< U >::value && ( sizeof( U ) > 1 ), onumstream& >::type
 	put_num( U value )
+	{
+		return m_reverse_order ? put_num< detail::reverse_of_native >( value ) : put_num< bend::order::native >( value );
+	}
+
+	template< class U >
+	typename std::enable_if< std::is_arithmetic< U >::value && ( sizeof( U ) > 1 ), onumstream& >::type
+	put_num( U value, std::error_code& err )
+	{
+		return m_reverse_order ? put_num< detail::reverse_of_native >( value, err ) : put_num< bend::order::native >( value, err );
+	}
+
+	/*
+	 * Writes value in the byte order given by the template argument,
+	 * regardless of the stream's byte order. Fixed-format framing (and
+	 * code that knows the stream's order statically) uses these to avoid
+	 * the per-value order test.
+	 */
+
+	template< bend::order Order, class U >
+	typename std::enable_if< std::is_arithmetic< U >::value, onumstream& >::type
+	put_num( U value )
 	{
 		constexpr std::size_t usize = sizeof( U );
 		using ctype = typename detail::canonical_type< usize >::type;
-		ctype cval = m_reverse_order ? bend::endian_reverse( reinterpret_cast< ctype& >( value ) ) : reinterpret_cast< ctype& >( value );
+		ctype cval = detail::to_order< Order >( reinterpret_cast< ctype& >( value ) );
 		m_strmbuf->putn( reinterpret_cast< byte_type* >( &cval ), usize );
 		return *this;
 	}
 
-	template< class U >
-	typename std::enable_if< std::is_arithmetic< U >::value && ( sizeof( U ) > 1 ), onumstream& >::type
+	template< bend::order Order, class U >
+	typename std::enable_if< std::is_arithmetic< U >::value, onumstream& >::type
 	put_num( U value, std::error_code& err )
 	{
 		constexpr std::size_t usize = sizeof( U );
 		using ctype = typename detail::canonical_type< usize >::type;
-		ctype cval = m_reverse_order ? bend::endian_reverse( reinterpret_cast< ctype& >( value ) ) : reinterpret_cast< ctype& >( value );
+		ctype cval = detail::to_order< Order >( reinterpret_cast< ctype& >( value ) );
 		m_strmbuf->putn( reinterpret_cast< byte_type* >( &cval ), usize, err );
 		return *this;
 	}
 
+	/*
+	 * Writes count values from src in the stream's byte order. When no
+	 * reordering is needed, this is a single putn() of the whole range.
+	 */
+
+	template< class U >
+	typename std::enable_if< detail::is_bulk_num< U >::value, onumstream& >::type
+	put_nums( U const* src, size_type count )
+	{
+		std::error_code err;
+		put_nums( src, count, err );
+		if ( err )
+		{
+			throw std::system_error{ err };
+		}
+		return *this;
+	}
+
+	template< class U >
+	typename std::enable_if< detail::is_bulk_num< U >::value, onumstream& >::type
+	put_nums( U const* src, size_type count, std::error_code& err )
+	{
+		constexpr std::size_t usize = sizeof( U );
+		using ctype = typename detail::canonical_type< usize >::type;
+
+		clear_error( err );
+
+		if ( usize == 1 || ! m_reverse_order )
+		{
+			m_strmbuf->putn( reinterpret_cast< const byte_type* >( src ), count * usize, err );
+		}
+		else
+		{
+			constexpr std::size_t chunk_count = detail::bulk_chunk_size / usize;
+			ctype chunk[ chunk_count ];
+			auto bp = reinterpret_cast< const byte_type* >( src );
+			while ( count > 0 )
+			{
+				auto n = std::min( count, chunk_count );
+				::memcpy( chunk, bp, n * usize );
+				detail::reverse_nums( chunk, n );
+				m_strmbuf->putn( reinterpret_cast< const byte_type* >( chunk ), n * usize, err );
+				if ( err ) break;
+				bp += n * usize;
+				count -= n;
+			}
+		}
+		return *this;
+	}
+
  	size_type 
 	size()
 	{
@@ -465,21 +595,45 @@ public:
 		return static_cast< U >( get( err ) );
 	}
 
+	/*
+	 * Reads a value in the stream's byte order, tested once per value as
+	 * for onumstream::put_num(); every deserializer reads through here.
+	 */
+
 	template< class U >
 	typename std::enable_if< std::is_arithmetic< U >::value && ( sizeof( U ) > 1 ), U >::type 
 	get_num()
+	{
+		return m_reverse_order ? get_num< U, detail::reverse_of_native >() : get_num< U, bend::order::native >();
+	}
+
+	template< class U >
+	typename std::enable_if< std::is_arithmetic< U >::value && ( sizeof( U ) > 1 ), U >::type 
+	get_num( std::error_code& err )
+	{
+		return m_reverse_order ? get_num< U, detail::reverse_of_native >( err ) : get_num< U, bend::order::native >( err );
+	}
+
+	/*
+	 * Reads a value stored in the byte order given by the template argument,
+	 * regardless of the stream's byte order.
+	 */
+
+	template< class U, bend::order Order >
+	typename std::enable_if< std::is_arithmetic< U >::value, U >::type 
+	get_num()
 	{
 		constexpr std::size_t usize = sizeof( U );
 		using ctype = typename detail::canonical_type< usize >::type;
 
 		ctype cval;
 		m_strmbuf->getn( reinterpret_cast< byte_type* >( &cval ), usize );
-		cval = m_reverse_order ? bend::endian_reverse( cval ) : cval;
+		cval = detail::to_order< Order >( cval );
 		return reinterpret_cast< U& >( cval );
 	}
 
-	template< class U >
-	typename std::enable_if< std::is_arithmetic< U >::value && ( sizeof( U ) > 1 ), U >::type 
+	template< class U, bend::order Order >
+	typename std::enable_if< std::is_arithmetic< U >::value, U >::type 
 	get_num( std::error_code& err )
 	{
 		constexpr std::size_t usize = sizeof( U );
@@ -489,12 +643,106 @@ public:
 		m_strmbuf->getn( reinterpret_cast< byte_type* >( &cval ), usize, err );
 		if ( err ) goto exit;
 
-		cval = m_reverse_order ? bend::endian_reverse( cval ) : cval;
+		cval = detail::to_order< Order >( cval );
 
 	exit:
 		return reinterpret_cast< U& >( cval );
 	}
 
+	/*
+	 * Reads count values into dst, converting from the stream's byte order.
+	 * Reports errc::read_past_end_of_stream if fewer than count values are
+	 * available.
+	 */
+
+	template< class U >
+	typename std::enable_if< detail::is_bulk_num< U >::value, size_type >::type
+	get_nums( U* dst, size_type count )
+	{
+		std::error_code err;
+		auto result = get_nums( dst, count, err );
+		if ( err )
+		{
+			throw std::system_error{ err };
+		}
+		return result;
+	}
+
+	template< class U >
+	typename std::enable_if< detail::is_bulk_num< U >::value, size_type >::type
+	get_nums( U* dst, size_type count, std::error_code& err )
+	{
+		constexpr std::size_t usize = sizeof( U );
+		using ctype = typename detail::canonical_type< usize >::type;
+
+		size_type got = 0;
+
+		clear_error( err );
+
+		if ( usize == 1 || ! m_reverse_order )
+		{
+			got = getn( reinterpret_cast< byte_type* >( dst ), count * usize, err ) / usize;
+		}
+		else
+		{
+			constexpr std::size_t chunk_count = detail::bulk_chunk_size / usize;
+			ctype chunk[ chunk_count ];
+			auto bp = reinterpret_cast< byte_type* >( dst );
+			while ( got < count )
+			{
+				auto n = std::min( count - got, chunk_count );
+				getn( reinterpret_cast< byte_type* >( chunk ), n * usize, err );
+				if ( err ) break;
+				detail::reverse_nums( chunk, n );
+				::memcpy( bp, chunk, n * usize );
+				bp += n * usize;
+				got += n;
+			}
+		}
+		return got;
+	}
+
+	/*
+	 * Reads count values into c, replacing its contents. The container is
+	 * grown as the values arrive, so a corrupt count fails with
+	 * errc::read_past_end_of_stream instead of allocating it up front.
+	 */
+
+	template< class C >
+	typename std::enable_if< detail::is_bulk_num< typename C::value_type >::value >::type
+	get_nums( C& c, size_type count )
+	{
+		std::error_code err;
+		get_nums( c, count, err );
+		if ( err )
+		{
+			throw std::system_error{ err };
+		}
+	}
+
+	template< class C >
+	typename std::enable_if< detail::is_bulk_num< typename C::value_type >::value >::type
+	get_nums( C& c, size_type count, std::error_code& err )
+	{
+		constexpr size_type chunk_count = detail::untrusted_chunk_size / sizeof( typename C::value_type );
+
+		clear_error( err );
+		c.clear();
+
+		while ( c.size() < count )
+		{
+			auto pos = c.size();
+			auto n = std::min( count - pos, chunk_count );
+			c.resize( pos + n );
+			get_nums( &c[ pos ], n, err );
+			if ( err )
+			{
+				c.resize( pos );
+				break;
+			}
+		}
+	}
+
 	buffer
 	getn( size_type nbytes, bool throw_on_incomplete = true );
 
@@ -507,6 +755,18 @@ public:
 	size_type
 	getn( byte_type* dst, size_type nbytes, std::error_code& err, bool err_on_incomplete = true  );
 
+	buffer
+	get_slice( size_type nbytes )
+	{
+		return m_strmbuf->get_slice( nbytes );
+	}
+
+	buffer
+	get_slice( size_type nbytes, std::error_code& err )
+	{
+		return m_strmbuf->get_slice( nbytes, err );
+	}
+
 	bend::order
 	byte_order() const
 	{
@@ -0,0 +1,110 @@
+#ifndef NODEOZE_BSTREAM_OBCOMPRESSBUF_H
+#define NODEOZE_BSTREAM_OBCOMPRESSBUF_H
+
+#include <nodeoze/bstream/obstreambuf.h>
+#include <nodeoze/bstream/error.h>
+#include <memory>
+#include <vector>
+
+#ifndef NODEOZE_BSTREAM_DEFAULT_OBCOMPRESSBUF_SIZE
+#define NODEOZE_BSTREAM_DEFAULT_OBCOMPRESSBUF_SIZE  16384UL
+#endif
+
+namespace nodeoze 
+{
+namespace bstream 
+{
+
+/*
+ * A stream buffer that deflates (zlib format, via the bundled miniz) everything
+ * written to it and passes the compressed bytes on to another stream buffer.
+ * Compression happens as the put area is flushed, so the uncompressed image is
+ * never held in memory as a whole.
+ *
+ * The compressed stream is only complete after finish() has been called;
+ * the destructor calls it if necessary, but cannot report errors. The output
+ * is strictly sequential, so seeking is limited to the current position.
+ */
+
+class obcompressbuf : public obstreambuf
+{
+public:
+
+    static constexpr int no_compression = 0;
+    static constexpr int best_speed = 1;
+    static constexpr int default_level = 6;
+    static constexpr int best_compression = 9;
+
+    obcompressbuf( std::unique_ptr< obstreambuf > sink, std::error_code& err, int level = default_level,
+            size_type buffer_size = NODEOZE_BSTREAM_DEFAULT_OBCOMPRESSBUF_SIZE );
+
+    obcompressbuf( std::unique_ptr< obstreambuf > sink, int level = default_level,
+            size_type buffer_size = NODEOZE_BSTREAM_DEFAULT_OBCOMPRESSBUF_SIZE );
+
+    obcompressbuf( obcompressbuf&& ) = delete;
+    obcompressbuf( obcompressbuf const& ) = delete;
+    obcompressbuf& operator=( obcompressbuf&& ) = delete;
+    obcompressbuf& operator=( obcompressbuf const& ) = delete;
+
+    virtual ~obcompressbuf();
+
+    void
+    finish( std::error_code& err );
+
+    void
+    finish();
+
+    bool
+    is_finished() const noexcept
+    {
+        return m_finished;
+    }
+
+    obstreambuf&
+    sink() noexcept
+    {
+        return *m_sink;
+    }
+
+protected:
+
+    virtual void
+    really_flush( std::error_code& err ) override;
+
+    virtual void
+    really_touch( std::error_code& err ) override;
+
+    virtual position_type
+    really_seek( seek_anchor where, offset_type offset, std::error_code& err ) override;
+
+    virtual void
+    really_overflow( size_type n, std::error_code& err ) override;
+
+private:
+
+    struct zstate;
+
+    void
+    init( int level, std::error_code& err );
+
+    void
+    compress( const byte_type* src, size_type n, bool finish, std::error_code& err );
+
+    void
+    reset_ptrs()
+    {
+        auto base = m_data.data();
+        set_ptrs( base, base, base + m_data.size() );
+    }
+
+    std::unique_ptr< obstreambuf >  m_sink;
+    std::vector< byte_type >        m_data;
+    std::vector< byte_type >        m_zdata;
+    std::unique_ptr< zstate >       m_zstate;
+    bool                            m_finished;
+};
+
+} // namespace bstream
+} // namespace nodeoze
+
+#endif // NODEOZE_BSTREAM_OBCOMPRESSBUF_H
@@ -0,0 +1,76 @@
+#ifndef NODEOZE_BSTREAM_OBCOUNTBUF_H
+#define NODEOZE_BSTREAM_OBCOUNTBUF_H
+
+#include <nodeoze/bstream/obstreambuf.h>
+#include <array>
+
+#ifndef NODEOZE_BSTREAM_OBCOUNTBUF_SCRATCH_SIZE
+#define NODEOZE_BSTREAM_OBCOUNTBUF_SCRATCH_SIZE  1024UL
+#endif
+
+namespace nodeoze 
+{
+namespace bstream 
+{
+
+/*
+ * A stream buffer that discards everything written to it, keeping only
+ * the positions. Bytes pass through a small scratch area that is recycled
+ * on every overflow; size() reports the number of bytes that would have
+ * been produced (the high watermark, so seeks are accounted for).
+ */
+
+class obcountbuf : public obstreambuf
+{
+public:
+
+    obcountbuf()
+    :
+    obstreambuf{},
+    m_scratch{}
+    {
+        reset_ptrs();
+    }
+
+    obcountbuf( obcountbuf&& ) = delete;
+    obcountbuf( obcountbuf const& ) = delete;
+    obcountbuf& operator=( obcountbuf&& ) = delete;
+    obcountbuf& operator=( obcountbuf const& ) = delete;
+
+    size_type
+    size()
+    {
+        return static_cast< size_type >( tell( seek_anchor::end ) );
+    }
+
+    obcountbuf&
+    clear() noexcept;
+
+protected:
+
+    virtual void
+    really_flush( std::error_code& err ) override;
+
+    virtual void
+    really_touch( std::error_code& err ) override;
+
+    virtual position_type
+    really_seek( seek_anchor where, offset_type offset, std::error_code& err ) override;
+
+    virtual void
+    really_overflow( size_type n, std::error_code& err ) override;
+
+    void
+    reset_ptrs()
+    {
+        auto base = m_scratch.data();
+        set_ptrs( base, base, base + m_scratch.size() );
+    }
+
+    std::array< byte_type, NODEOZE_BSTREAM_OBCOUNTBUF_SCRATCH_SIZE >    m_scratch;
+};
+
+} // namespace bstream
+} // namespace nodeoze
+
+#endif // NODEOZE_BSTREAM_OBCOUNTBUF_H
@@ -3,6 +3,7 @@
 
 #include <fcntl.h>
 #include <vector>
+#include <memory>
 #include <nodeoze/bstream/obstreambuf.h>
 
 #ifndef NODEOZE_BSTREAM_DEFAULT_OBFILEBUF_SIZE
@@ -28,7 +29,8 @@ public:
     m_is_open{ rhs.m_is_open },
     m_mode{ rhs.m_mode },
     m_flags{ rhs.m_flags },
-    m_fd{ rhs.m_fd }
+    m_fd{ rhs.m_fd },
+    m_writer{ std::move( rhs.m_writer ) }
     {}
 
     obfilebuf( std::string const& filename, open_mode mode, std::error_code& err, size_type buffer_size = NODEOZE_BSTREAM_DEFAULT_OBFILEBUF_SIZE )
@@ -39,7 +41,8 @@ public:
     m_is_open{ false },
     m_mode{ mode },
     m_flags{ to_flags( mode ) },
-    m_fd{ -1 }
+    m_fd{ -1 },
+    m_writer{}
     {
         reset_ptrs();
         really_open( err );
@@ -53,7 +56,8 @@ public:
     m_is_open{ false },
     m_mode{ mode },
     m_flags{ to_flags( mode ) },
-    m_fd{ -1 }
+    m_fd{ -1 },
+    m_writer{}
     {
         reset_ptrs();
         std::error_code err;
@@ -72,11 +76,14 @@ public:
     m_is_open{ false },
     m_mode{ mode },
     m_flags{ to_flags( m_mode ) },
-    m_fd{ -1 }
+    m_fd{ -1 },
+    m_writer{}
     {
         reset_ptrs();
     }
 
+    virtual ~obfilebuf();
+
     void
     open( std::string const& filename, open_mode mode, std::error_code& err )
     {
@@ -187,6 +194,36 @@ public:
     position_type
     truncate();
 
+    /*
+     * Switches to background writing: flushed buffers are handed to a dedicated
+     * I/O thread, and the caller continues filling a spare buffer. buffer_count
+     * (at least 2) bounds the number of buffers in use; when all of them are
+     * queued, flushing blocks until the I/O thread catches up. Errors from the
+     * I/O thread are reported by the next flush, sync, truncate or close.
+     */
+
+    void
+    async( std::size_t buffer_count, std::error_code& err );
+
+    void
+    async( std::size_t buffer_count = 2 );
+
+    bool
+    is_async() const noexcept
+    {
+        return m_writer != nullptr;
+    }
+
+    /*
+     * Flushes, waits for any queued background writes, and fsyncs the file.
+     */
+
+    void
+    sync( std::error_code& err );
+
+    void
+    sync();
+
 protected:
 
     virtual bool
@@ -228,6 +265,9 @@ private:
     void 
     really_open( std::error_code& err );
 
+    void
+    drain( std::error_code& err );
+
     constexpr int
     to_flags( open_mode mode )
     {
@@ -242,12 +282,21 @@ private:
         }
     }
 
+    class async_writer;
+
+    struct async_writer_deleter
+    {
+        void
+        operator()( async_writer* writer ) const;
+    };
+
     std::vector< byte_type >    m_data;
     std::string                 m_filename;
     bool                        m_is_open;
     open_mode                   m_mode;
     int                         m_flags;
     int                         m_fd;
+    std::unique_ptr< async_writer, async_writer_deleter >   m_writer;
 };
 
 } // namespace bstream
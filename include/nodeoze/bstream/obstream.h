@@ -37,7 +37,7 @@
 #include <nodeoze/bstream/numstream.h>
 #include <nodeoze/bstream/typecode.h>
 #include <vector>
-#include <unordered_map>
+#include <algorithm>
 
 
 namespace nodeoze
@@ -57,41 +57,114 @@ public:
 
     using saved_ptr_info = std::pair< poly_tag_type , std::size_t >;	// ( type_tag, saved_serial_num )
 
+	/*
+	 * Open-addressing table keyed by object address, so lookups do not
+	 * touch shared_ptr reference counts. Saved pointers are retained
+	 * (one reference per distinct object) so an address cannot be reused
+	 * by a different object while the stream remembers it. clear() keeps
+	 * the allocations for reuse.
+	 */
+
 	class ptr_deduper
 	{
 	public:
 
+		ptr_deduper()
+		:
+		m_slots( initial_capacity ),
+		m_size{ 0 },
+		m_retained{}
+		{
+			m_retained.reserve( initial_capacity / 2 );
+		}
+
 		bool
-		is_saved( std::shared_ptr< void > ptr, saved_ptr_info& info ) const
+		is_saved( const void* ptr, saved_ptr_info& info ) const
 		{
-			auto it = m_saved_ptrs.find( ptr );
-			if ( it == m_saved_ptrs.end() )
-			{
-				return false;
-			}
-			else
+			for ( auto i = slot_index( ptr ); ; i = ( i + 1 ) & ( m_slots.size() - 1 ) )
 			{
-				info = it->second;
-				return true;
+				auto const& slot = m_slots[ i ];
+				if ( slot.key == ptr )
+				{
+					info = slot.info;
+					return true;
+				}
+				else if ( slot.key == nullptr )
+				{
+					return false;
+				}
 			}
 		}
 
-		void save_ptr( std::shared_ptr< void > ptr, poly_tag_type tag )
+		void save_ptr( std::shared_ptr< const void > ptr, poly_tag_type tag )
 		{
-			m_saved_ptrs.emplace( ptr, std::make_pair( tag, m_next_serial_num ) );
-			++m_next_serial_num;
+			if ( ( m_size + 1 ) * 2 > m_slots.size() )
+			{
+				grow();
+			}
+			insert( ptr.get(), std::make_pair( tag, m_retained.size() ) );
+			m_retained.emplace_back( std::move( ptr ) );
 		}
 
 		void
 		clear()
 		{
-			m_saved_ptrs.clear();
-			m_next_serial_num = 0;
+			if ( m_size > 0 )
+			{
+				std::fill( m_slots.begin(), m_slots.end(), slot_type{} );
+				m_size = 0;
+			}
+			m_retained.clear();
 		}
 
 	private:
-		std::size_t 														m_next_serial_num = 0;
-		std::unordered_map< std::shared_ptr< void >, saved_ptr_info >		m_saved_ptrs; 
+
+		static constexpr std::size_t initial_capacity = 64;
+
+		struct slot_type
+		{
+			const void*			key = nullptr;
+			saved_ptr_info		info{ invalid_tag, 0 };
+		};
+
+		std::size_t
+		slot_index( const void* ptr ) const noexcept
+		{
+			auto h = reinterpret_cast< std::uintptr_t >( ptr ) * 0x9E3779B97F4A7C15ULL;
+			return static_cast< std::size_t >( h >> 32 ) & ( m_slots.size() - 1 );
+		}
+
+		void
+		insert( const void* ptr, saved_ptr_info const& info )
+		{
+			auto i = slot_index( ptr );
+			while ( m_slots[ i ].key != nullptr )
+			{
+				i = ( i + 1 ) & ( m_slots.size() - 1 );
+			}
+			m_slots[ i ].key = ptr;
+			m_slots[ i ].info = info;
+			++m_size;
+		}
+
+		void
+		grow()
+		{
+			std::vector< slot_type > old( m_slots.size() * 2 );
+			old.swap( m_slots );
+			m_size = 0;
+			for ( auto const& slot : old )
+			{
+				if ( slot.key != nullptr )
+				{
+					insert( slot.key, slot.info );
+				}
+			}
+		}
+
+		std::vector< slot_type >							m_slots;
+		std::size_t											m_size;
+		std::vector< std::shared_ptr< const void > >		m_retained;
 	};
 
 	obstream( std::unique_ptr< bstream::obstreambuf > strmbuf, context_base const& cntxt = get_default_context() )
@@ -187,6 +260,49 @@ public:
 		return *this;
 	}
 
+	/*
+	 * Bulk numeric arrays are encoded as a single bin blob holding the
+	 * elements in the stream's byte order, rather than as a msgpack array
+	 * of individually encoded numbers. Read them back with
+	 * ibstream::read_num_array().
+	 */
+
+	template< class U >
+	typename std::enable_if_t< detail::is_bulk_num< U >::value, obstream& >
+	write_num_array( U const* src, std::size_t count )
+	{
+		write_blob_header( count * sizeof( U ) );
+		put_nums( src, count );
+		return *this;
+	}
+
+	template< class U >
+	typename std::enable_if_t< detail::is_bulk_num< U >::value, obstream& >
+	write_num_array( U const* src, std::size_t count, std::error_code& err )
+	{
+		write_blob_header( count * sizeof( U ), err );
+		if ( err ) goto exit;
+
+		put_nums( src, count, err );
+
+	exit:
+		return *this;
+	}
+
+	template< class U, class Alloc >
+	typename std::enable_if_t< detail::is_bulk_num< U >::value, obstream& >
+	write_num_array( std::vector< U, Alloc > const& vec )
+	{
+		return write_num_array( vec.data(), vec.size() );
+	}
+
+	template< class U, class Alloc >
+	typename std::enable_if_t< detail::is_bulk_num< U >::value, obstream& >
+	write_num_array( std::vector< U, Alloc > const& vec, std::error_code& err )
+	{
+		return write_num_array( vec.data(), vec.size(), err );
+	}
+
 	obstream&
 	write_object_header( std::uint32_t size )
 	{
@@ -539,6 +655,16 @@ struct serializer< nodeoze::string_alias >
 	}
 };
 
+template< class Traits, class Alloc >
+struct serializer< std::basic_string< char, Traits, Alloc >, 
+	std::enable_if_t< ! std::is_same< Alloc, std::allocator< char > >::value > >
+{
+	static obstream& put( obstream& os, std::basic_string< char, Traits, Alloc > const& value )
+	{
+		return serializer< std::string_view >::put( os, std::string_view{ value.data(), value.size() } );
+	}
+};
+
 template<>
 struct serializer< std::string >
 {
@@ -669,7 +795,7 @@ obstream::write_shared_ptr( std::shared_ptr< T > ptr )
 		if ( m_ptr_deduper )
 		{
 			saved_ptr_info info;
-			if ( m_ptr_deduper->is_saved( ptr, info ) )
+			if ( m_ptr_deduper->is_saved( ptr.get(), info ) )
 			{
 				write_array_header( 2 );
 				*this << info.first;	// type tag
@@ -677,7 +803,7 @@ obstream::write_shared_ptr( std::shared_ptr< T > ptr )
 			}
 			else
 			{
-				auto tag = m_context->get_type_tag( typeid( *ptr ) );
+				auto tag = m_context->get_dynamic_type_tag( *ptr );
 				write_array_header( 2 );
 				*this << tag;
 				*this << *ptr;
@@ -686,7 +812,7 @@ obstream::write_shared_ptr( std::shared_ptr< T > ptr )
 		}
 		else
 		{
-			auto tag = m_context->get_type_tag( typeid( *ptr ) );
+			auto tag = m_context->get_dynamic_type_tag( *ptr );
 			write_array_header( 2 );
 			*this << tag;
 			*this << *ptr;
@@ -705,7 +831,7 @@ obstream::write_as_unique_pointer( T *ptr )
 	}
 	else
 	{
-		auto tag = m_context->get_type_tag( typeid( *ptr ) );
+		auto tag = m_context->get_dynamic_type_tag( *ptr );
 		write_array_header( 2 );
 		*this << tag;
 		*this << *ptr;
@@ -0,0 +1,72 @@
+#ifndef NODEOZE_BSTREAM_OCBSTREAM_H
+#define NODEOZE_BSTREAM_OCBSTREAM_H
+
+#include <nodeoze/bstream/obstream.h>
+#include <nodeoze/bstream/obcountbuf.h>
+
+namespace nodeoze
+{
+namespace bstream
+{
+
+/*
+ * An output stream that runs the regular serializers but stores nothing;
+ * size() is the exact encoded size of everything written so far. Use the
+ * same context that will be used to encode for real, since shared pointer
+ * deduplication and byte order affect the result.
+ */
+
+class ocbstream : public obstream
+{
+public:
+    ocbstream( ocbstream const& ) = delete;
+    ocbstream( ocbstream&& ) = delete;
+
+    ocbstream( context_base const& cntxt = get_default_context() )
+    :
+    obstream{ std::make_unique< obcountbuf >(), cntxt }
+    {}
+
+    void
+    clear()
+    {
+        get_countbuf().clear();
+    }
+
+    obcountbuf&
+    get_countbuf()
+    {
+        return reinterpret_cast< obcountbuf& >( * m_strmbuf );
+    }
+};
+
+template< class T >
+inline size_type
+serialized_size( T const& obj, context_base const& cntxt = get_default_context() )
+{
+    ocbstream os{ cntxt };
+    os << obj;
+    return os.size();
+}
+
+template< class T >
+inline size_type
+serialized_size( T const& obj, context_base const& cntxt, std::error_code& err )
+{
+    clear_error( err );
+    size_type result = 0;
+    try
+    {
+        result = serialized_size( obj, cntxt );
+    }
+    catch ( std::system_error const& e )
+    {
+        err = e.code();
+    }
+    return result;
+}
+
+} // namespace bstream
+} // namespace nodeoze
+
+#endif // NODEOZE_BSTREAM_OCBSTREAM_H
@@ -71,6 +71,18 @@ public:
         get_filebuf().flush( err );
     }
 
+    void
+    sync()
+    {
+        get_filebuf().sync();
+    }
+
+    void
+    sync( std::error_code& err )
+    {
+        get_filebuf().sync( err );
+    }
+
     void
     close()
     {
@@ -23,7 +23,7 @@ struct value_deserializer< std::deque< T, Alloc >,
     get( ibstream& is )
     {
         auto length = is.read_array_header();
-        std::deque< T, Alloc > result;
+        std::deque< T, Alloc > result( stream_allocator< Alloc >( is ) );
         for ( auto i = 0u; i < length; ++i )
         {
             result.emplace_back( ibstream_initializer< T >::get( is ) );
@@ -24,7 +24,7 @@ struct value_deserializer< std::forward_list< T, Alloc >,
     get( ibstream& is )
     {
         auto length = is.read_array_header();
-        std::forward_list< T, Alloc > result;
+        std::forward_list< T, Alloc > result( stream_allocator< Alloc >( is ) );
         auto it = result.before_begin();
         for ( auto i = 0u; i < length; ++i )
         {
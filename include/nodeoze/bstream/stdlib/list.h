@@ -24,7 +24,7 @@ struct value_deserializer< std::list< T, Alloc >,
     get( ibstream& is )
     {
         auto length = is.read_array_header();
-        std::list< T, Alloc > result;
+        std::list< T, Alloc > result( stream_allocator< Alloc >( is ) );
         for ( auto i = 0u; i < length; ++i )
         {
             result.emplace_back( ibstream_initializer< T >::get( is ) );
@@ -28,7 +28,7 @@ struct value_deserializer< std::map< K, V, Compare, Alloc >,
         using pair_type = std::pair< K, V >;
         using map_type = std::map< K, V, Compare, Alloc >;
         auto length = is.read_array_header();
-        map_type result;
+        map_type result( stream_allocator< Alloc >( is ) );
         for ( auto i = 0u; i < length; ++i )
         {
             result.insert( is.read_as< pair_type >() );
@@ -55,7 +55,7 @@ struct value_deserializer< std::multimap< K, V, Compare, Alloc >,
         using pair_type = std::pair< K, V >;
         using map_type = std::multimap< K, V, Compare, Alloc >;
         auto length = is.read_array_header();
-        map_type result;
+        map_type result( stream_allocator< Alloc >( is ) );
         for ( auto i = 0u; i < length; ++i )
         {
             result.insert( is.read_as< pair_type >() );
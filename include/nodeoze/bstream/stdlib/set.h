@@ -24,7 +24,7 @@ struct value_deserializer< std::set< T, Compare, Alloc >,
     get( ibstream& is )
     {
         auto length = is.read_array_header();
-        std::set< T, Compare, Alloc > result;
+        std::set< T, Compare, Alloc > result( stream_allocator< Alloc >( is ) );
         for ( auto i = 0u; i < length; ++i )
         {
             result.emplace( ibstream_initializer< T >::get( is ) );
@@ -47,7 +47,7 @@ struct value_deserializer< std::multiset< T, Compare, Alloc >,
     get( ibstream& is )
     {
         auto length = is.read_array_header();
-        std::multiset< T, Compare, Alloc > result;
+        std::multiset< T, Compare, Alloc > result( stream_allocator< Alloc >( is ) );
         for ( auto i = 0u; i < length; ++i )
         {
             result.emplace( ibstream_initializer< T >::get( is ) );
@@ -29,7 +29,7 @@ struct value_deserializer< std::unordered_map< K, V, Hash, Equal, Alloc >,
         using map_type = std::unordered_map< K, V, Hash, Equal, Alloc >;
         
         auto length = is.read_array_header();
-        map_type result;
+        map_type result( stream_allocator< Alloc >( is ) );
         result.reserve( length );
         for ( auto i = 0u; i < length; ++i )
         {
@@ -58,7 +58,7 @@ struct value_deserializer< std::unordered_multimap< K, V, Hash, Equal, Alloc >,
         using map_type = std::unordered_multimap< K, V, Hash, Equal, Alloc >;
         
         auto length = is.read_array_header();
-        map_type result;
+        map_type result( stream_allocator< Alloc >( is ) );
         result.reserve( length );
         for ( auto i = 0u; i < length; ++i )
         {
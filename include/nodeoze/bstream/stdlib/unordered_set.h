@@ -24,7 +24,7 @@ struct value_deserializer< std::unordered_set< T, Hash, Equal, Alloc >,
     get( ibstream& is )
     {
         auto length = is.read_array_header();
-        std::unordered_set< T, Hash, Equal, Alloc > result;
+        std::unordered_set< T, Hash, Equal, Alloc > result( stream_allocator< Alloc >( is ) );
         for ( auto i = 0u; i < length; ++i )
         {
             result.emplace( ibstream_initializer< T >::get( is ) );
@@ -47,7 +47,7 @@ struct value_deserializer< std::unordered_multiset< T, Hash, Equal, Alloc >,
     get( ibstream& is )
     {
         auto length = is.read_array_header();
-        std::unordered_multiset< T, Hash, Equal, Alloc > result;
+        std::unordered_multiset< T, Hash, Equal, Alloc > result( stream_allocator< Alloc >( is ) );
         for ( auto i = 0u; i < length; ++i )
         {
             result.emplace( ibstream_initializer< T >::get( is ) );
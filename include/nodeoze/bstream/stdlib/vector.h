@@ -24,7 +24,7 @@ struct value_deserializer< std::vector< T, Alloc >,
     get( ibstream& is )
     {
         auto length = is.read_array_header();
-        std::vector< T, Alloc > result;
+        std::vector< T, Alloc > result( stream_allocator< Alloc >( is ) );
         result.reserve( length );
         for ( auto i = 0u; i < length; ++i )
         {
@@ -3,6 +3,18 @@
 
 #include <memory>
 
+#ifndef NODEOZE_BSTREAM_USE_PMR
+#  if defined( __has_include )
+#    if __has_include( <memory_resource> )
+#      define NODEOZE_BSTREAM_USE_PMR 1
+#    endif
+#  endif
+#endif
+
+#if NODEOZE_BSTREAM_USE_PMR
+#include <memory_resource>
+#endif
+
 namespace nodeoze
 {
 namespace bstream
@@ -29,6 +29,9 @@
 
 #include <mutex>
 #include <list>
+#include <atomic>
+#include <functional>
+#include <memory>
 
 namespace nodeoze {
 
@@ -114,6 +117,180 @@ private:
 	std::recursive_mutex	m_mutex;
 };
 
+/*
+ * Lock-free multi-producer/single-consumer queue.
+ *
+ * Producers push onto an atomic singly linked list with a single CAS. The
+ * consumer detaches the whole list with one exchange and processes it as a
+ * batch, in FIFO order. push() reports whether the queue was empty, which is
+ * exactly when the consumer needs to be woken up; producers that find it
+ * non-empty can rely on a wakeup already being pending.
+ */
+
+template < class Data >
+class mpsc_queue
+{
+public:
+
+	inline mpsc_queue()
+	:
+		m_head( nullptr )
+	{
+	}
+
+	mpsc_queue( const mpsc_queue& ) = delete;
+	mpsc_queue& operator=( const mpsc_queue& ) = delete;
+
+	inline ~mpsc_queue()
+	{
+		free( m_head.exchange( nullptr, std::memory_order_acquire ) );
+	}
+
+	/*
+	 * Returns true if the queue was empty before this push.
+	 */
+
+	inline bool
+	push( Data &&data )
+	{
+		auto head	= m_head.load( std::memory_order_relaxed );
+		auto n		= new node{ std::move( data ), head };
+
+		// once published, n belongs to the consumer, so only the local copy of
+		// the previous head may be examined afterwards
+
+		while ( !m_head.compare_exchange_weak( head, n, std::memory_order_release, std::memory_order_relaxed ) )
+		{
+			n->m_next = head;
+		}
+
+		return head == nullptr;
+	}
+
+	inline bool
+	empty() const
+	{
+		return m_head.load( std::memory_order_acquire ) == nullptr;
+	}
+
+	/*
+	 * Consumer only. Detaches everything pushed so far and invokes func on
+	 * each item in the order pushed. Items pushed while the batch is being
+	 * processed are left for the next call. Returns the number of items
+	 * processed.
+	 *
+	 * If func throws, the item it threw on is dropped and the rest of the
+	 * batch goes back on the queue, ahead of anything pushed since. No push
+	 * reports those as a wakeup, so a consumer that survives the exception
+	 * should call consume_all() again.
+	 */
+
+	template < class Func >
+	inline std::size_t
+	consume_all( Func &&func )
+	{
+		std::size_t count = 0;
+
+		// the list is newest-first; reverse it to restore push order
+
+		node *batch = nullptr;
+		node *n		= m_head.exchange( nullptr, std::memory_order_acquire );
+
+		while ( n )
+		{
+			auto next	= n->m_next;
+			n->m_next	= batch;
+			batch		= n;
+			n			= next;
+		}
+
+		batch_guard guard{ *this, batch };
+
+		while ( guard.m_remaining )
+		{
+			std::unique_ptr< node > item( guard.m_remaining );
+			guard.m_remaining = item->m_next;
+			func( item->m_data );
+			++count;
+		}
+
+		return count;
+	}
+
+private:
+
+	struct node
+	{
+		Data	m_data;
+		node	*m_next;
+	};
+
+	// puts back what's left of a batch if func throws
+
+	struct batch_guard
+	{
+		~batch_guard()
+		{
+			if ( m_remaining )
+			{
+				m_queue.requeue( m_remaining );
+			}
+		}
+
+		mpsc_queue	&m_queue;
+		node		*m_remaining;
+	};
+
+	inline void
+	requeue( node *batch )
+	{
+		// back to newest-first
+
+		node *list = nullptr;
+
+		while ( batch )
+		{
+			auto next		= batch->m_next;
+			batch->m_next	= list;
+			list			= batch;
+			batch			= next;
+		}
+
+		// producers only ever replace the head, so below it the list is ours
+		// and the batch can be spliced in after its last node
+
+		auto head = m_head.load( std::memory_order_acquire );
+
+		while ( !head )
+		{
+			if ( m_head.compare_exchange_weak( head, list, std::memory_order_release, std::memory_order_acquire ) )
+			{
+				return;
+			}
+		}
+
+		while ( head->m_next )
+		{
+			head = head->m_next;
+		}
+
+		head->m_next = list;
+	}
+
+	static inline void
+	free( node *n )
+	{
+		while ( n )
+		{
+			auto next = n->m_next;
+			delete n;
+			n = next;
+		}
+	}
+
+	std::atomic< node* > m_head;
+};
+
 }
 
 }
@@ -71,6 +71,182 @@ struct listener_base
 	id_type m_id;
 };
 
+/*
+ * one tag per listener signature; emit() compares these instead of
+ * dynamic_pointer_cast'ing every listener
+ */
+
+template< class T >
+inline const void*
+type_id()
+{
+	static const char tag = 0;
+	return &tag;
+}
+
+/*
+ * The listeners registered for one event name. The first inline_capacity
+ * entries live in the list itself, so the common case of one or two
+ * listeners needs no separate allocation. While an emit() is walking the
+ * list, removed entries are only marked dead (the listener object stays
+ * alive) and are compacted away when the outermost emit() finishes.
+ * Listeners added during an emit() are appended and not invoked by it.
+ *
+ * The emitter holds each list through a shared_ptr and emit() takes a
+ * reference for its duration, so a handler may destroy the emitter itself.
+ */
+
+class listener_list
+{
+public:
+
+	static constexpr std::size_t inline_capacity = 2;
+
+	struct entry
+	{
+		const void						*type = nullptr;
+		std::unique_ptr< listener_base >	listener;
+	};
+
+	listener_list()
+	{
+	}
+
+	listener_list( const listener_list& ) = delete;
+
+	listener_list&
+	operator=( const listener_list& ) = delete;
+
+	inline std::size_t
+	size() const
+	{
+		return m_size;
+	}
+
+	inline std::size_t
+	live() const
+	{
+		return m_live;
+	}
+
+	inline entry&
+	operator[]( std::size_t i )
+	{
+		return ( i < inline_capacity ) ? m_inline[ i ] : m_overflow[ i - inline_capacity ];
+	}
+
+	inline void
+	push_back( const void *type, std::unique_ptr< listener_base > listener )
+	{
+		if ( m_size < inline_capacity )
+		{
+			m_inline[ m_size ].type		= type;
+			m_inline[ m_size ].listener	= std::move( listener );
+		}
+		else
+		{
+			m_overflow.emplace_back();
+			m_overflow.back().type		= type;
+			m_overflow.back().listener	= std::move( listener );
+		}
+
+		++m_size;
+		++m_live;
+	}
+
+	inline void
+	remove( std::size_t i )
+	{
+		auto &e = ( *this )[ i ];
+
+		if ( e.type )
+		{
+			e.type = nullptr;
+			--m_live;
+
+			if ( !m_emitting )
+			{
+				compact();
+			}
+		}
+	}
+
+	inline void
+	clear()
+	{
+		for ( auto i = 0u; i < m_size; ++i )
+		{
+			( *this )[ i ].type = nullptr;
+		}
+
+		m_live = 0;
+
+		if ( !m_emitting )
+		{
+			compact();
+		}
+	}
+
+	struct emitting
+	{
+		emitting( listener_list &list )
+		:
+			m_list( list )
+		{
+			++m_list.m_emitting;
+		}
+
+		~emitting()
+		{
+			if ( ( --m_list.m_emitting == 0 ) && ( m_list.m_live != m_list.m_size ) )
+			{
+				m_list.compact();
+			}
+		}
+
+		listener_list &m_list;
+	};
+
+private:
+
+	inline void
+	compact()
+	{
+		std::size_t w = 0;
+
+		for ( auto r = 0u; r < m_size; ++r )
+		{
+			auto &e = ( *this )[ r ];
+
+			if ( e.type )
+			{
+				if ( w != r )
+				{
+					( *this )[ w ] = std::move( e );
+				}
+
+				++w;
+			}
+		}
+
+		for ( auto i = w; i < std::min( m_size, inline_capacity ); ++i )
+		{
+			m_inline[ i ].type = nullptr;
+			m_inline[ i ].listener.reset();
+		}
+
+		m_overflow.resize( ( w > inline_capacity ) ? w - inline_capacity : 0 );
+
+		m_size = w;
+	}
+
+	entry				m_inline[ inline_capacity ];
+	std::vector< entry >	m_overflow;
+	std::size_t			m_size		= 0;
+	std::size_t			m_live		= 0;
+	std::size_t			m_emitting	= 0;
+};
+
 }
 
 struct string
@@ -79,7 +255,7 @@ struct string
 	 * modified from https://stackoverflow.com/questions/2111667/compile-time-string-hashing#9842857
 	 */
 
-	constexpr std::size_t
+	static constexpr std::size_t
 	hash_string( const char* input )
 	{
 		size_t hash = sizeof(size_t) == 8 ? 0xcbf29ce484222325 : 0x811c9dc5;
@@ -120,6 +296,17 @@ struct string
 		const_cast< char* >( str )[ size ] = '\0';
 	}
 
+	/*
+	 * a non-owning key over s, for lookups that must not allocate; s has to
+	 * outlive it
+	 */
+
+	static string
+	view( const std::string &s )
+	{
+		return string( s.c_str(), s.size() );
+	}
+
 	string( const string &rhs ) = delete;
 
 	string( string &&rhs )
@@ -153,6 +340,17 @@ struct string
     std::size_t	size;
 	std::size_t	hash;
 	bool		del;
+
+private:
+
+	string( const char *s, std::size_t n )
+	:
+		str( s ),
+		size( n ),
+		hash( hash_string( s ) ),
+		del( false )
+	{
+	}
 };
 
 /*
@@ -163,7 +361,7 @@ struct string
  * 
  */
 
-template< class Key = string, class Table = std::unordered_map< Key, std::vector< std::shared_ptr< detail::listener_base > > > >
+template< class Key = string, class Table = std::unordered_map< Key, std::shared_ptr< detail::listener_list > > >
 class emitter
 {
 public:
@@ -203,14 +401,14 @@ public:
 
 			if ( it == m_listeners.end() )
 			{
-				it = m_listeners.emplace( std::piecewise_construct, std::forward_as_tuple( std::move( id ) ), std::forward_as_tuple( std::vector< std::shared_ptr< detail::listener_base > >() ) ).first;
+				it = m_listeners.emplace( std::move( id ), std::make_shared< detail::listener_list >() ).first;
 			}
 
 			assert( it != m_listeners.end() );
 
-			it->second.emplace_back( std::make_shared< listener<> >( listener_id, std::move( handler ) ) );
+			it->second->push_back( detail::type_id< listener<> >(), std::make_unique< listener<> >( listener_id, std::move( handler ) ) );
 
-			emit( "newListener", it->first.str, it->second.size() );
+			emit( "newListener", it->first.str, it->second->live() );
 		}
 
 		return listener_id;        
@@ -230,14 +428,14 @@ public:
 
 			if ( it == m_listeners.end() )
 			{
-				it = m_listeners.emplace( std::piecewise_construct, std::forward_as_tuple( std::move( id ) ), std::forward_as_tuple( std::vector< std::shared_ptr< detail::listener_base > >() ) ).first;
+				it = m_listeners.emplace( std::move( id ), std::make_shared< detail::listener_list >() ).first;
 			}
 
 			assert( it != m_listeners.end() );
 
-			it->second.emplace_back( std::make_shared< listener< Args... > >( listener_id, std::move( handler ) ) );
+			it->second->push_back( detail::type_id< listener< Args... > >(), std::make_unique< listener< Args... > >( listener_id, std::move( handler ) ) );
 
-			emit( "newListener", it->first.str, it->second.size() );
+			emit( "newListener", it->first.str, it->second->live() );
 		}
 
 		return listener_id;        
@@ -297,14 +495,20 @@ public:
 
 		if ( it != m_listeners.end() )
 		{
-			auto new_end = std::remove_if( it->second.begin(), it->second.end(), [listener_id]( auto &listener ) mutable
+			auto &list = *it->second;
+
+			for ( auto i = 0u; i < list.size(); ++i )
 			{
-				return listener->m_id == listener_id;
-			} );
+				auto &e = list[ i ];
 
-			it->second.erase( new_end, it->second.end() );
+				if ( e.type && ( e.listener->m_id == listener_id ) )
+				{
+					list.remove( i );
+					break;
+				}
+			}
 
-			emit( "removeListener", id.str, it->second.size() );
+			emit( "removeListener", id.str, list.live() );
 		}
 	}
 
@@ -315,52 +519,46 @@ public:
 
 		if ( it != m_listeners.end() )
 		{
-			it->second.clear();
-			emit( "removeListener", id.str, it->second.size() );
+			it->second->clear();
+			emit( "removeListener", id.str, it->second->live() );
 		}
 	}
 
+	/*
+	 * Listeners match on the decayed argument types, as they are registered
+	 * with by-value parameters. Arguments are forwarded by reference and each
+	 * listener receives them as lvalues, so emit() itself neither copies nor
+	 * allocates; a literal name is not copied either.
+	 */
+
+    template< std::size_t N, typename... Args >
+	inline void
+	emit( char const ( &id )[ N ], Args&&... args )
+	{
+		emit( key_type( id ), std::forward< Args >( args )... );
+	}
+
     template< typename... Args >
 	inline void
-	emit( key_type id, Args... args )
+	emit( const std::string &id, Args&&... args )
+	{
+		emit( key_type::view( id ), std::forward< Args >( args )... );
+	}
+
+    template< typename... Args >
+	inline void
+	emit( const key_type &id, Args&&... args )
 	{
 		auto it = m_listeners.find( id );
 
-		if ( it != m_listeners.end() )
+		if ( ( it != m_listeners.end() ) && ( it->second->live() > 0 ) )
 		{
-			std::vector< std::shared_ptr< listener< Args... > > > listeners;
+			// keeps the list, and so the running listener, alive should a
+			// handler destroy this emitter
 
-			listeners.reserve( it->second.size() );
+			auto list = it->second;
 
-			auto bit = it->second.begin();
-
-			while ( bit != it->second.end() )
-			{
-				auto l = std::dynamic_pointer_cast< listener< Args...> >( *bit );
-
-				if ( l )
-				{
-					listeners.emplace_back( std::move( l ) );
-
-					if ( ( *bit )->is_once() )
-					{
-						bit = it->second.erase( bit );
-					}
-					else
-					{
-						bit++;
-					}
-				}
-				else
-				{
-					bit++;
-				}
-			}
-					
-			for ( auto &listener : listeners )
-			{
-				listener->m_handler( args... );
-			}
+			dispatch< listener< typename std::decay< Args >::type... > >( *list, args... );
 		}
 	}
 
@@ -383,6 +581,32 @@ private:
         std::function< void ( Args... ) > m_handler;
     };
 
+	template< typename Listener, typename... Args >
+	inline void
+	dispatch( detail::listener_list &list, Args&... args )
+	{
+		detail::listener_list::emitting guard( list );
+		auto type	= detail::type_id< Listener >();
+		auto n		= list.size();
+
+		for ( auto i = 0u; i < n; ++i )
+		{
+			auto &e = list[ i ];
+
+			if ( e.type == type )
+			{
+				auto l = static_cast< Listener* >( e.listener.get() );
+
+				if ( l->is_once() )
+				{
+					list.remove( i );
+				}
+
+				l->m_handler( args... );
+			}
+		}
+	}
+
     template< typename T >
     struct function_traits
 	:
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2013-2017, Collobos Software Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+ 
+
+#ifndef _nodeoze_inline_function_h
+#define _nodeoze_inline_function_h
+
+#include <type_traits>
+#include <functional>
+#include <cstddef>
+#include <utility>
+#include <new>
+
+namespace nodeoze {
+
+template< class Signature, std::size_t Capacity = 48 >
+class inline_function;
+
+/*
+ * A copyable, type erased callable like std::function, but with Capacity
+ * bytes of inline storage. Callables that fit (and are nothrow movable) are
+ * stored in place; larger ones fall back to the heap. std::function stores
+ * only about two pointers' worth inline, so a lambda capturing a promise and
+ * a user callback always allocates there and usually does not here.
+ */
+
+template< class R, class... Args, std::size_t Capacity >
+class inline_function< R ( Args... ), Capacity >
+{
+public:
+
+	inline_function() noexcept
+	{
+	}
+
+	inline_function( std::nullptr_t ) noexcept
+	{
+	}
+
+	template<
+		class F,
+		class D = typename std::decay< F >::type,
+		class = typename std::enable_if< !std::is_same< D, inline_function >::value >::type,
+		class = typename std::enable_if< std::is_convertible< decltype( std::declval< D& >()( std::declval< Args >()... ) ), R >::value || std::is_void< R >::value >::type >
+	inline_function( F &&func )
+	{
+		assign< D >( std::forward< F >( func ) );
+	}
+
+	inline_function( const inline_function &rhs )
+	{
+		if ( rhs.m_manage )
+		{
+			rhs.m_manage( op::copy, m_storage, const_cast< unsigned char* >( rhs.m_storage ) );
+			m_invoke = rhs.m_invoke;
+			m_manage = rhs.m_manage;
+		}
+	}
+
+	inline_function( inline_function &&rhs ) noexcept
+	{
+		take( rhs );
+	}
+
+	~inline_function()
+	{
+		clear();
+	}
+
+	inline_function&
+	operator=( const inline_function &rhs )
+	{
+		if ( this != &rhs )
+		{
+			inline_function tmp( rhs );
+			clear();
+			take( tmp );
+		}
+
+		return *this;
+	}
+
+	inline_function&
+	operator=( inline_function &&rhs ) noexcept
+	{
+		if ( this != &rhs )
+		{
+			clear();
+			take( rhs );
+		}
+
+		return *this;
+	}
+
+	inline_function&
+	operator=( std::nullptr_t ) noexcept
+	{
+		clear();
+		return *this;
+	}
+
+	template<
+		class F,
+		class D = typename std::decay< F >::type,
+		class = typename std::enable_if< !std::is_same< D, inline_function >::value >::type >
+	inline_function&
+	operator=( F &&func )
+	{
+		inline_function tmp( std::forward< F >( func ) );
+		clear();
+		take( tmp );
+		return *this;
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return m_invoke != nullptr;
+	}
+
+	R
+	operator()( Args... args ) const
+	{
+		if ( !m_invoke )
+		{
+			throw std::bad_function_call();
+		}
+
+		return m_invoke( const_cast< unsigned char* >( m_storage ), std::forward< Args >( args )... );
+	}
+
+	friend bool
+	operator==( const inline_function &f, std::nullptr_t ) noexcept
+	{
+		return !f;
+	}
+
+	friend bool
+	operator!=( const inline_function &f, std::nullptr_t ) noexcept
+	{
+		return static_cast< bool >( f );
+	}
+
+private:
+
+	enum class op
+	{
+		copy,
+		move,
+		destroy
+	};
+
+	typedef R ( *invoke_f )( void *storage, Args&&... args );
+	typedef void ( *manage_f )( op o, void *dst, void *src );
+
+	template< class D >
+	struct fits
+	{
+		static const bool value = ( sizeof( D ) <= Capacity ) && ( alignof( D ) <= alignof( std::max_align_t ) ) && std::is_nothrow_move_constructible< D >::value;
+	};
+
+	template< class D, class F >
+	typename std::enable_if< fits< D >::value >::type
+	assign( F &&func )
+	{
+		new ( m_storage ) D( std::forward< F >( func ) );
+
+		m_invoke = []( void *storage, Args&&... args ) -> R
+		{
+			return ( *reinterpret_cast< D* >( storage ) )( std::forward< Args >( args )... );
+		};
+
+		m_manage = []( op o, void *dst, void *src )
+		{
+			switch ( o )
+			{
+				case op::copy:
+				{
+					new ( dst ) D( *reinterpret_cast< const D* >( src ) );
+				}
+				break;
+
+				case op::move:
+				{
+					new ( dst ) D( std::move( *reinterpret_cast< D* >( src ) ) );
+					reinterpret_cast< D* >( src )->~D();
+				}
+				break;
+
+				case op::destroy:
+				{
+					reinterpret_cast< D* >( dst )->~D();
+				}
+				break;
+			}
+		};
+	}
+
+	template< class D, class F >
+	typename std::enable_if< !fits< D >::value >::type
+	assign( F &&func )
+	{
+		*reinterpret_cast< D** >( m_storage ) = new D( std::forward< F >( func ) );
+
+		m_invoke = []( void *storage, Args&&... args ) -> R
+		{
+			return ( **reinterpret_cast< D** >( storage ) )( std::forward< Args >( args )... );
+		};
+
+		m_manage = []( op o, void *dst, void *src )
+		{
+			switch ( o )
+			{
+				case op::copy:
+				{
+					*reinterpret_cast< D** >( dst ) = new D( **reinterpret_cast< const D* const* >( src ) );
+				}
+				break;
+
+				case op::move:
+				{
+					*reinterpret_cast< D** >( dst ) = *reinterpret_cast< D** >( src );
+				}
+				break;
+
+				case op::destroy:
+				{
+					delete *reinterpret_cast< D** >( dst );
+				}
+				break;
+			}
+		};
+	}
+
+	void
+	take( inline_function &rhs ) noexcept
+	{
+		if ( rhs.m_manage )
+		{
+			rhs.m_manage( op::move, m_storage, rhs.m_storage );
+			m_invoke		= rhs.m_invoke;
+			m_manage		= rhs.m_manage;
+			rhs.m_invoke	= nullptr;
+			rhs.m_manage	= nullptr;
+		}
+	}
+
+	void
+	clear() noexcept
+	{
+		if ( m_manage )
+		{
+			auto manage = m_manage;
+
+			m_invoke = nullptr;
+			m_manage = nullptr;
+			manage( op::destroy, m_storage, nullptr );
+		}
+	}
+
+	alignas( std::max_align_t ) unsigned char	m_storage[ Capacity ];
+	invoke_f									m_invoke = nullptr;
+	manage_f									m_manage = nullptr;
+};
+
+}
+
+#endif
@@ -135,10 +135,30 @@ public:
 			return *this;
 		}
 
+		/*
+		 * Sets SO_REUSEPORT on the listening socket, so that one server per
+		 * runloop in a runloop_group can bind the same endpoint and let the
+		 * kernel spread incoming connections across them.
+		 */
+
+		bool
+		reuse_port() const
+		{
+			return m_reuse_port;
+		}
+
+		options&
+		reuse_port( bool val )
+		{
+			m_reuse_port = val;
+			return *this;
+		}
+
 	private:
 
 		ip::endpoint	m_endpoint;
 		std::int32_t	m_qsize = 5;
+		bool			m_reuse_port = false;
 	};
 
 	using ptr = std::shared_ptr< server >;
@@ -159,6 +179,30 @@ public:
 
 namespace udp {
 
+/*
+ * A received datagram and its sender, or a datagram to send and its
+ * destination.
+ */
+
+struct datagram
+{
+	ip::endpoint	peer;
+	buffer			data;
+};
+
+/*
+ * events:
+ *
+ * on( "message", []( buffer b, ip::endpoint from ) {} );
+ * on( "messages", []( std::vector< net::udp::datagram > batch ) {} );
+ * "error"
+ *
+ * A socket created with a batch_size greater than one emits "messages"
+ * rather than "message". On Linux it then reads with recvmmsg(2) and
+ * sends with sendmmsg(2), up to batch_size datagrams per system call;
+ * elsewhere every batch holds a single datagram.
+ */
+
 class socket : public event::emitter<>
 {
 public:
@@ -179,9 +223,23 @@ public:
 			return m_endpoint;
 		}
 
+		std::size_t
+		batch_size() const
+		{
+			return m_batch_size;
+		}
+
+		options&
+		batch_size( std::size_t val )
+		{
+			m_batch_size = val;
+			return *this;
+		}
+
 	private:
 
-		ip::endpoint m_endpoint;
+		ip::endpoint	m_endpoint;
+		std::size_t		m_batch_size = 1;
 	};
 
 	enum class multicast_membership_type
@@ -199,6 +257,28 @@ public:
 	create( options options, std::error_code &err );
 
 	virtual ~socket() = 0;
+
+	virtual ip::endpoint
+	name() const = 0;
+
+	virtual std::error_code
+	set_membership( const ip::endpoint &endpoint, const ip::address iface, multicast_membership_type membership ) = 0;
+
+	virtual std::error_code
+	set_broadcast( bool val ) = 0;
+
+	virtual promise< void >
+	send( buffer buf, const ip::endpoint &to ) = 0;
+
+	/*
+	 * Resolves once every datagram in the batch has been sent.
+	 */
+
+	virtual promise< void >
+	send( std::vector< datagram > batch ) = 0;
+
+	virtual void
+	close() = 0;
 };
 
 }
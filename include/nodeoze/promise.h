@@ -28,6 +28,8 @@
 #define _nodeoze_promise_h
 
 #include <nodeoze/runloop.h>
+#include <nodeoze/timer_wheel.h>
+#include <nodeoze/inline_function.h>
 #include <nodeoze/macros.h>
 #include <nodeoze/deque.h>
 #include <functional>
@@ -38,11 +40,22 @@
 #include <cstdlib>
 #include <cassert>
 
+#if defined( __cpp_impl_coroutine ) && defined( __has_include )
+#	if __has_include( <coroutine> )
+#		include <coroutine>
+#		include <optional>
+#		define NODEOZE_HAS_COROUTINES 1
+#	endif
+#endif
+
 namespace nodeoze {
 
 template< typename T >
 class promise;
 
+template< typename T >
+struct __promise_awaiter;
+
 
 template< typename T >
 inline std::ostream&
@@ -99,20 +112,135 @@ struct is_void_promise< promise< void > > : public std::integral_constant< bool,
 {
 };
 
+/*
+ * Shared state is recycled through a per-thread free list, one per object
+ * size, so a promise chain on a busy runloop stops going to the allocator
+ * once it has warmed up. Promises never cross threads, so the list needs no
+ * locking. It holds at most max_pooled blocks; the rest go back to the heap.
+ */
+
+template< std::size_t Size >
+class __promise_pool
+{
+public:
+
+	static const std::size_t max_pooled = 256;
+
+	static void*
+	allocate()
+	{
+		auto &list = free_list();
+
+		if ( list.head )
+		{
+			auto block = list.head;
+			list.head = block->next;
+			--list.count;
+			return block;
+		}
+
+		return ::operator new( Size );
+	}
+
+	static void
+	deallocate( void *ptr )
+	{
+		if ( !destroyed() )
+		{
+			auto &list = free_list();
+
+			if ( list.count < max_pooled )
+			{
+				auto block = static_cast< node* >( ptr );
+				block->next = list.head;
+				list.head = block;
+				++list.count;
+				return;
+			}
+		}
+
+		::operator delete( ptr );
+	}
+
+private:
+
+	struct node
+	{
+		node *next;
+	};
+
+	struct list
+	{
+		~list()
+		{
+			destroyed() = true;
+
+			while ( head )
+			{
+				auto block = head;
+				head = block->next;
+				::operator delete( block );
+			}
+		}
+
+		node		*head	= nullptr;
+		std::size_t	count	= 0;
+	};
+
+	static list&
+	free_list()
+	{
+		static thread_local list l;
+		return l;
+	}
+
+	/*
+	 * promises released by thread_local or static destructors that run after
+	 * the list is gone go straight back to the heap
+	 */
+
+	static bool&
+	destroyed()
+	{
+		static thread_local bool d = false;
+		return d;
+	}
+};
+
+/*
+ * The continuation slots are inline_functions sized so that the lambdas
+ * then() builds (a promise plus the caller's callable) are stored in place.
+ * The timer is only a handle to a timer_wheel entry, allocated by timeout()
+ * and null otherwise.
+ */
+
 template< class T >
 struct __promise_shared
 {
-	typedef std::function< void ( T&& ) >				resolve_f;
-	typedef std::function< void ( std::error_code ) >	reject_f;
-	typedef std::function< void () >					finally_f;
+	typedef inline_function< void ( T&& ) >				resolve_f;
+	typedef inline_function< void ( std::error_code ) >	reject_f;
+	typedef inline_function< void () >					finally_f;
 	typedef deque< T >									maybe_array_type;
+
+	static void*
+	operator new( std::size_t size )
+	{
+		assert( size == sizeof( __promise_shared ) );
+		return __promise_pool< sizeof( __promise_shared ) >::allocate();
+	}
+
+	static void
+	operator delete( void *ptr )
+	{
+		__promise_pool< sizeof( __promise_shared ) >::deallocate( ptr );
+	}
 	
 	bool				resolved;
 	bool				rejected;
 	resolve_f			resolve;
 	reject_f			reject;
 	finally_f			finally;
-	runloop::event		timer;
+	timer_wheel::timer	timer;
 	std::uint32_t		refs;
 	T					val;
 	std::error_code		err;
@@ -121,17 +249,30 @@ struct __promise_shared
 template<>
 struct __promise_shared< void >
 {
-	typedef std::function< void () >					resolve_f;
-	typedef std::function< void ( std::error_code ) >	reject_f;
-	typedef std::function< void () >					finally_f;
+	typedef inline_function< void () >					resolve_f;
+	typedef inline_function< void ( std::error_code ) >	reject_f;
+	typedef inline_function< void () >					finally_f;
 	typedef void										maybe_array_type;
+
+	static void*
+	operator new( std::size_t size )
+	{
+		assert( size == sizeof( __promise_shared ) );
+		return __promise_pool< sizeof( __promise_shared ) >::allocate();
+	}
+
+	static void
+	operator delete( void *ptr )
+	{
+		__promise_pool< sizeof( __promise_shared ) >::deallocate( ptr );
+	}
 	
 	bool				resolved;
 	bool				rejected;
 	resolve_f			resolve;
 	reject_f			reject;
 	finally_f			finally;
-	runloop::event		timer;
+	timer_wheel::timer	timer;
 	std::uint32_t		refs;
 	std::error_code		err;
 };
@@ -268,6 +409,7 @@ public:
 
 		if ( m_shared && !m_shared->resolved && !m_shared->rejected )
 		{
+			cancel_timer();
 			m_shared->resolved = true;
 
 			if ( m_shared->resolve )
@@ -293,6 +435,7 @@ public:
 
 		if ( m_shared && !m_shared->resolved && !m_shared->rejected )
 		{
+			cancel_timer();
 			m_shared->resolved = true;
 		
 			if ( m_shared->resolve )
@@ -322,6 +465,7 @@ public:
 
 		if ( m_shared && !m_shared->resolved && !m_shared->rejected )
 		{
+			cancel_timer();
 			m_shared->resolved = true;
 			
 			if ( m_shared->resolve )
@@ -350,6 +494,7 @@ public:
 
 		if ( m_shared && !m_shared->resolved && !m_shared->rejected )
 		{
+			cancel_timer();
 			m_shared->err		= err;
 			m_shared->rejected	= true;
 
@@ -519,11 +664,14 @@ public:
 		m_shared->resolve	= nullptr;
 		m_shared->reject	= nullptr;
 		m_shared->finally	= nullptr;
+		m_shared->timer		= nullptr;
 		m_shared->refs		= 1;
 	}
 
 private:
 
+	template< typename > friend struct __promise_awaiter;
+
 	template<
 		typename Resolve,
 		typename Reject,
@@ -860,15 +1008,13 @@ private:
 
 		if ( m_shared )
 		{
-			m_shared->timer = runloop::shared().create( timeout );
-
 			auto copy = *this;
 
-			runloop::shared().schedule( m_shared->timer, [copy]( auto event ) mutable
+			m_shared->timer = runloop::current().timers().schedule( timeout, [copy]() mutable
 			{
-				nunused( event );
+				// the wheel has already released this timer
 
-				copy.cancel_timer();
+				copy.m_shared->timer = nullptr;
 
 				if ( !copy.is_finished() )
 				{
@@ -883,8 +1029,9 @@ private:
 	{
 		if ( m_shared && m_shared->timer )
 		{
-			runloop::shared().cancel( m_shared->timer );
+			auto timer = m_shared->timer;
 			m_shared->timer = nullptr;
+			timer_wheel::cancel( timer );
 		}
 	}
 	
@@ -1147,4 +1294,221 @@ nodeoze::promise< void >::any( promises_type promises )
 	return ret;
 }
 
+#if defined( NODEOZE_HAS_COROUTINES )
+
+namespace nodeoze {
+
+/*
+ * co_await on a promise suspends the coroutine until the promise settles and
+ * then resumes it as a runloop microtask (see runloop::next_tick()), so the
+ * coroutine continues once the resolve() or reject() call has returned
+ * rather than inside it. The resolved value is returned and a rejection is
+ * thrown as std::system_error. The continuations installed here capture only
+ * a pointer to the awaiter, so they are stored inline in the shared state and
+ * no step allocates. As with then(), a promise can only be awaited once.
+ */
+
+template< typename T >
+struct __promise_awaiter
+{
+	explicit __promise_awaiter( promise< T > p )
+	:
+		m_promise( std::move( p ) )
+	{
+	}
+
+	bool
+	await_ready() const noexcept
+	{
+		return m_promise.is_finished();
+	}
+
+	void
+	await_suspend( std::coroutine_handle<> handle )
+	{
+		m_handle = handle;
+
+		m_promise.m_shared->resolve = [this]( T &&val )
+		{
+			m_val.emplace( std::move( val ) );
+			resume_later();
+		};
+
+		m_promise.m_shared->reject = [this]( std::error_code err )
+		{
+			nunused( err );
+			resume_later();
+		};
+	}
+
+	T
+	await_resume()
+	{
+		auto shared = m_promise.m_shared;
+
+		if ( shared->rejected )
+		{
+			throw std::system_error( shared->err );
+		}
+
+		return m_val ? std::move( *m_val ) : std::move( shared->val );
+	}
+
+	void
+	resume_later()
+	{
+		runloop::current().next_tick( [this]()
+		{
+			m_handle.resume();
+		} );
+	}
+
+	promise< T >				m_promise;
+	std::coroutine_handle<>		m_handle;
+	std::optional< T >			m_val;
+};
+
+template<>
+struct __promise_awaiter< void >
+{
+	explicit __promise_awaiter( promise< void > p )
+	:
+		m_promise( std::move( p ) )
+	{
+	}
+
+	bool
+	await_ready() const noexcept
+	{
+		return m_promise.is_finished();
+	}
+
+	void
+	await_suspend( std::coroutine_handle<> handle )
+	{
+		m_handle = handle;
+
+		m_promise.m_shared->resolve = [this]()
+		{
+			resume_later();
+		};
+
+		m_promise.m_shared->reject = [this]( std::error_code err )
+		{
+			nunused( err );
+			resume_later();
+		};
+	}
+
+	void
+	await_resume()
+	{
+		if ( m_promise.m_shared->rejected )
+		{
+			throw std::system_error( m_promise.m_shared->err );
+		}
+	}
+
+	void
+	resume_later()
+	{
+		runloop::current().next_tick( [this]()
+		{
+			m_handle.resume();
+		} );
+	}
+
+	promise< void >				m_promise;
+	std::coroutine_handle<>		m_handle;
+};
+
+template< typename T >
+inline __promise_awaiter< T >
+operator co_await( promise< T > p )
+{
+	return __promise_awaiter< T >( std::move( p ) );
+}
+
+/*
+ * The promise_type that lets a coroutine return promise< T >. The coroutine
+ * starts running immediately and its frame is released when it finishes.
+ * An escaping std::system_error rejects with its code; any other exception
+ * rejects with std::errc::state_not_recoverable.
+ */
+
+template< typename T >
+struct __promise_coroutine_base
+{
+	promise< T >
+	get_return_object()
+	{
+		return m_promise;
+	}
+
+	std::suspend_never
+	initial_suspend() const noexcept
+	{
+		return {};
+	}
+
+	std::suspend_never
+	final_suspend() const noexcept
+	{
+		return {};
+	}
+
+	void
+	unhandled_exception()
+	{
+		try
+		{
+			throw;
+		}
+		catch ( const std::system_error &exc )
+		{
+			m_promise.reject( exc.code() );
+		}
+		catch ( ... )
+		{
+			m_promise.reject( make_error_code( std::errc::state_not_recoverable ) );
+		}
+	}
+
+	promise< T > m_promise;
+};
+
+template< typename T >
+struct __promise_coroutine : public __promise_coroutine_base< T >
+{
+	void
+	return_value( T val )
+	{
+		this->m_promise.resolve( std::move( val ) );
+	}
+};
+
+template<>
+struct __promise_coroutine< void > : public __promise_coroutine_base< void >
+{
+	void
+	return_void()
+	{
+		m_promise.resolve();
+	}
+};
+
+}
+
+namespace std {
+
+template< typename T, typename... Args >
+struct coroutine_traits< nodeoze::promise< T >, Args... >
+{
+	typedef nodeoze::__promise_coroutine< T > promise_type;
+};
+
+}
+
+#endif
+
 #endif
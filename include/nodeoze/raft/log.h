@@ -150,7 +150,7 @@ public:
 		frame_os << fp;
 		auto frame_buffer = frame_os.get_buffer();
 		m_os.write_blob( frame_buffer );
-		m_os.put_num( frame_buffer.checksum() );
+		m_os.put_num< bend::order::big >( frame_buffer.checksum() );
 		if ( flush )
 		{
 			m_os.flush();
@@ -176,7 +176,7 @@ public:
 	{
 		buffer framebuf = is.read_blob();
 		auto buffer_checksum = framebuf.checksum();
-		auto frame_checksum = is.get_num< buffer::checksum_type >();
+		auto frame_checksum = is.get_num< buffer::checksum_type, bend::order::big >();
 		if ( buffer_checksum != frame_checksum )
 		{
 			throw std::system_error{ make_error_code( raft::errc::log_checksum_error ) };
@@ -30,8 +30,14 @@
 #include <nodeoze/concurrent.h>
 #include <nodeoze/singleton.h>
 #include <nodeoze/filesystem.h>
+#include <nodeoze/inline_function.h>
 #include <functional>
 #include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <array>
 
 #if defined( WIN32 )
 #	include <winsock2.h>
@@ -39,6 +45,8 @@
 
 namespace nodeoze {
 
+class timer_wheel;
+
 #if defined( WIN32 )
 	typedef SOCKET	native_socket_type;
 #else
@@ -69,8 +77,76 @@ public:
 	typedef std::function< void ( void ) >															dispatch_f;
 	typedef std::function< void ( event e ) >														event_f;
 	typedef std::function< void ( event e, const filesystem::path &path, int events, int status ) >	fs_event_f;
+	typedef std::function< void ( const char *tag, std::chrono::microseconds elapsed ) >			slow_callback_f;
+	typedef inline_function< void () >																microtask_f;
+
+	/*
+	 * A power of two histogram: bucket 0 counts zeros, bucket i counts
+	 * samples in [ 2^(i-1), 2^i ), and the last bucket takes everything
+	 * larger.
+	 */
+
+	struct histogram
+	{
+		static const std::size_t buckets = 32;
+
+		std::uint64_t							count	= 0;
+		std::uint64_t							sum		= 0;
+		std::uint64_t							max		= 0;
+		std::array< std::uint64_t, buckets >	bucket	= {};
+
+		/*
+		 * An upper bound on the value at fraction p ( 0.0 - 1.0 ) of the
+		 * samples, accurate to a factor of two.
+		 */
+
+		std::uint64_t
+		percentile( double p ) const;
+	};
+
+	/*
+	 * A snapshot of the loop's instrumentation, see instrument().
+	 */
+
+	struct health
+	{
+		std::uint64_t	iterations		= 0;
+		histogram		lag;				// usec per iteration spent in callbacks, i.e. unable to poll
+		histogram		queue_depth;		// dispatched functions drained per wakeup
+		histogram		queue_wait;			// usec from dispatch() to invocation
+		std::uint64_t	slow_callbacks	= 0;
+		std::uint64_t	events_live		= 0;	// events created and not yet closed, kept whether or not instrumented
+		std::uint64_t	events_pooled	= 0;	// closed events held for reuse by create()
+	};
 	
 	~runloop();
+
+	/*
+	 * The runloop driving the calling thread: its own loop for a thread
+	 * started by a runloop_group, shared() for every other thread. Handles
+	 * are created on, and results should be dispatched back to, this loop.
+	 */
+
+	static runloop&
+	current();
+
+	/*
+	 * The underlying uv_loop_t.
+	 */
+
+	void*
+	native() const
+	{
+		return m_loop;
+	}
+
+	/*
+	 * The timer wheel for this loop, created on first use. Cheaper than
+	 * create( msec ) for large numbers of short lived timeouts.
+	 */
+
+	timer_wheel&
+	timers();
 	
 	event
 	create( native_socket_type fd, int mask );
@@ -109,6 +185,65 @@ public:
 	void
 	dispatch( dispatch_f f );
 
+	/*
+	 * As above, naming the call site for slow callback tracing. tag must
+	 * outlive the call, typically a string literal.
+	 */
+
+	void
+	dispatch( dispatch_f f, const char *tag );
+
+	/*
+	 * Queues f to run on this loop's thread as soon as the current callback
+	 * returns: after every I/O, timer or dispatched callback, and in any case
+	 * before the loop polls again. Microtasks queued by a microtask run in
+	 * the same pass, as with process.nextTick(). Unlike dispatch() there is
+	 * no lock and no wakeup, so it must be called on the loop's thread.
+	 */
+
+	void
+	next_tick( microtask_f f );
+
+	/*
+	 * Runs the queued microtasks now. The loop does this after each callback
+	 * it makes; code that takes libuv callbacks directly (net, fs) calls it
+	 * before returning to libuv, so microtasks never wait for the check phase.
+	 */
+
+	void
+	drain_microtasks();
+
+	/*
+	 * Turns instrumentation on or off. While on, the loop records loop lag
+	 * from its prepare/check handle pair, and the depth and wait time of
+	 * the dispatch queue. Call on the loop's thread.
+	 */
+
+	void
+	instrument( bool enable );
+
+	inline bool
+	is_instrumented() const
+	{
+		return m_instrumented.load( std::memory_order_relaxed );
+	}
+
+	/*
+	 * While instrumented, calls func on the loop's thread for every
+	 * dispatched function or event callback that runs for longer than
+	 * threshold. Call on the loop's thread; a null func turns tracing off.
+	 */
+
+	void
+	trace_slow_callbacks( std::chrono::microseconds threshold, slow_callback_f func );
+
+	/*
+	 * Safe to call from any thread.
+	 */
+
+	health
+	snapshot() const;
+
 	void
 	run( mode_t how = mode_t::normal );
 	
@@ -117,8 +252,12 @@ public:
 	
 protected:
 
+	friend class runloop_group;
+
 	runloop();
 
+	runloop( void *loop, bool owns_loop );
+
 	static void
 	on_wakeup( void *handle, int status );
 
@@ -131,11 +270,132 @@ protected:
 	static void
 	on_path( void *handle, const char *filename, int events, int status );
 
+	static void
+	on_close( void *handle );
+
+	/*
+	 * Storage for events comes from a per-loop free list that cancel() refills
+	 * once libuv has closed the handle, so short lived timers and polls stop
+	 * going to the allocator. free_event() destroys the event and recycles it.
+	 */
+
+	void*
+	allocate_event();
+
+	void
+	free_event( void *e );
+
+	class instrumentation;
+
+	struct dispatch_item
+	{
+		dispatch_f								m_func;
+		const char								*m_tag;
+		std::chrono::steady_clock::time_point	m_enqueued;
+	};
+
+	static void
+	on_prepare( void *handle );
+
+	static void
+	on_check( void *handle );
+
 	void
 	drain_dispatch_queue();
+
+	template< class Func >
+	void
+	invoke( const char *tag, Func &&func );
 	
+	void										*m_loop;
+	bool										m_owns_loop;
 	void										*m_handle;
-	concurrent::queue< dispatch_f >				m_queue;
+	void										*m_prepare;
+	void										*m_check;
+	concurrent::mpsc_queue< dispatch_item >		m_queue;
+	std::vector< microtask_f >					m_microtasks;
+	std::size_t									m_microtask_head;
+	void										*m_free_events;
+	std::atomic< std::size_t >					m_events_live;
+	std::atomic< std::size_t >					m_events_pooled;
+	std::unique_ptr< timer_wheel >				m_timers;
+	std::unique_ptr< instrumentation >			m_instrumentation;
+	std::atomic< bool >							m_instrumented;
+};
+
+/*
+ * A fixed set of runloops, each with its own libuv loop running on its own
+ * thread. Code running on one of these threads sees that loop as
+ * runloop::current(), so handles it creates stay on that loop.
+ *
+ * To spread incoming TCP connections, create one listener per loop with
+ * dispatch_all() and net::tcp::server::options::reuse_port(); the kernel then
+ * balances accepted connections across the listeners.
+ *
+ * Handles must be closed before the group is destroyed. The constructor
+ * throws std::system_error if libuv can't initialize a loop.
+ */
+
+class runloop_group
+{
+public:
+
+	explicit runloop_group( std::size_t count = std::thread::hardware_concurrency() );
+
+	runloop_group( const runloop_group& ) = delete;
+	runloop_group& operator=( const runloop_group& ) = delete;
+
+	~runloop_group();
+
+	inline std::size_t
+	size() const
+	{
+		return m_members.size();
+	}
+
+	inline runloop&
+	at( std::size_t index )
+	{
+		return *m_members[ index ].m_loop;
+	}
+
+	/*
+	 * Round-robin selection, for distributing work across the loops.
+	 */
+
+	runloop&
+	next();
+
+	inline void
+	dispatch( std::size_t index, runloop::dispatch_f f )
+	{
+		at( index ).dispatch( std::move( f ) );
+	}
+
+	/*
+	 * Invokes f on every loop, on that loop's thread.
+	 */
+
+	void
+	dispatch_all( std::function< void ( runloop& ) > f );
+
+	/*
+	 * Stops every loop and joins the threads. Called by the destructor.
+	 */
+
+	void
+	stop();
+
+private:
+
+	struct member
+	{
+		std::unique_ptr< runloop >	m_loop;
+		std::thread					m_thread;
+	};
+
+	std::vector< member >			m_members;
+	std::atomic< std::size_t >		m_next;
 };
 
 }
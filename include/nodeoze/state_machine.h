@@ -400,7 +400,7 @@ private:
 
 				if ( !m_event_queue.empty() )
 				{
-					runloop::shared().dispatch( [=]() mutable
+					runloop::current().next_tick( [=]() mutable
 					{
 						if ( !m_event_queue.empty() )
 						{
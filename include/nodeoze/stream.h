@@ -31,6 +31,7 @@
 #include <nodeoze/event.h>
 #include <nodeoze/deque.h>
 #include <unordered_map>
+#include <vector>
 #include <queue>
 
 namespace nodeoze {
@@ -57,9 +58,22 @@ public:
 		m_highwater_mark = val;
 	}
 
+	std::uint32_t
+	lowwater_mark()
+	{
+		return m_lowwater_mark;
+	}
+
+	void
+	set_lowwater_mark( std::uint32_t val )
+	{
+		m_lowwater_mark = val;
+	}
+
 protected:
 
-	std::uint32_t	m_highwater_mark;
+	std::uint32_t	m_highwater_mark	= 16 * 1024;
+	std::uint32_t	m_lowwater_mark		= 0;
 };
 
 class writable : public base
@@ -72,23 +86,86 @@ public:
 
 	virtual ~writable();
 
+	/*
+	 * Up to write_window() writes are in flight at once. Whatever is written
+	 * while the window is full is queued and, as writes complete, flushed
+	 * together: up to writev_max_buffers buffers or writev_max_bytes bytes
+	 * per really_writev().
+	 */
+
+	static const std::size_t writev_max_buffers	= 64;
+	static const std::size_t writev_max_bytes	= 256 * 1024;
+
+	/*
+	 * Returns false once the bytes queued or in flight reach the high water
+	 * mark. "drain" is then emitted when they fall to the low water mark,
+	 * and, as before, whenever every write has completed.
+	 */
+
 	bool
 	write( buffer b, std::function< void () > cb = nullptr );
 
 	void
 	end();
 
+	inline std::size_t
+	write_window() const
+	{
+		return m_window;
+	}
+
+	/*
+	 * Streams whose really_write() can only handle one write at a time must
+	 * leave this at 1.
+	 */
+
+	inline void
+	set_write_window( std::size_t val )
+	{
+		m_window = ( val > 0 ) ? val : 1;
+	}
+
+	/*
+	 * Bytes written but not yet completed.
+	 */
+
+	inline std::size_t
+	buffered() const
+	{
+		return m_buffered;
+	}
+
 protected:
 
 	void
-	start_write( buffer b );
+	start_write();
+
+	void
+	write_done( std::size_t bytes );
 
 	virtual promise< void >
 	really_write( buffer b );
 
-	bool					m_writing	= false;
+	/*
+	 * Writes bufs in order, taking them and leaving bufs empty. Streams that
+	 * can gather (net::tcp::socket) override this to write them all at once;
+	 * the default writes them one at a time with really_write().
+	 */
+
+	virtual promise< void >
+	really_writev( std::vector< buffer > &bufs );
+
+	void
+	write_each( std::shared_ptr< std::queue< buffer > > bufs, promise< void > ret );
+
+	bool					m_writing		= false;
 	std::queue< buffer >	m_queue;
-	bool					m_ended		= false;
+	std::vector< buffer >	m_batch;
+	std::size_t				m_buffered		= 0;
+	std::size_t				m_in_flight		= 0;
+	std::size_t				m_window		= 1;
+	bool					m_need_drain	= false;
+	bool					m_ended			= false;
 };
 
 /*
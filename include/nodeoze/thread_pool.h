@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2013-2017, Collobos Software Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+ 
+
+#ifndef _nodeoze_thread_pool_h
+#define _nodeoze_thread_pool_h
+
+#include <nodeoze/promise.h>
+#include <nodeoze/runloop.h>
+#include <nodeoze/singleton.h>
+#include <condition_variable>
+#include <system_error>
+#include <type_traits>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+namespace nodeoze {
+
+/*
+ * A fixed set of worker threads for CPU bound work, so that it stays off the
+ * runloop threads.
+ *
+ * Each worker owns a bounded deque. Tasks submitted from a worker go on that
+ * worker's own deque and run LIFO; tasks submitted from any other thread are
+ * spread round robin. An idle worker steals the oldest task from its peers.
+ *
+ * submit() captures runloop::current() and resolves or rejects the returned
+ * promise on that runloop, so continuations never run on a pool thread. If
+ * every deque is full the promise is rejected with
+ * std::errc::resource_unavailable_try_again, rather than blocking the
+ * caller's runloop.
+ */
+
+class thread_pool
+{
+	NODEOZE_DECLARE_SINGLETON( thread_pool )
+
+public:
+
+	typedef std::function< void ( void ) > task_f;
+
+	explicit thread_pool( std::size_t threads = std::thread::hardware_concurrency(), std::size_t queue_depth = 1024 );
+
+	thread_pool( const thread_pool& ) = delete;
+	thread_pool& operator=( const thread_pool& ) = delete;
+
+	~thread_pool();
+
+	inline std::size_t
+	size() const
+	{
+		return m_workers.size();
+	}
+
+	/*
+	 * Runs func on a worker. The result, or the code of a std::system_error
+	 * thrown by func, is delivered on the caller's runloop. Any other
+	 * exception rejects with std::errc::state_not_recoverable.
+	 */
+
+	template< class Func >
+	auto
+	submit( Func &&func )
+	{
+		typedef typename std::decay< decltype( func() ) >::type result_type;
+
+		promise< result_type >	ret;
+		auto					out = std::make_shared< pending< result_type > >( runloop::current(), ret );
+
+		auto err = post( [out, func = std::forward< Func >( func )]() mutable
+		{
+			deliver( *out, func );
+		} );
+
+		if ( err )
+		{
+			out->abandon();
+			ret.reject( err );
+		}
+
+		return ret;
+	}
+
+	/*
+	 * Queues a raw task. Returns std::errc::resource_unavailable_try_again
+	 * if the deques are full and std::errc::operation_canceled once the pool
+	 * is stopping.
+	 */
+
+	std::error_code
+	post( task_f task );
+
+	/*
+	 * Runs the queued tasks to completion and joins the workers. Called by
+	 * the destructor.
+	 */
+
+	void
+	stop();
+
+private:
+
+	struct worker
+	{
+		std::mutex				m_mutex;
+		std::deque< task_f >	m_tasks;
+		std::thread				m_thread;
+	};
+
+	/*
+	 * The worker's hold on a submitted promise. Promise reference counts are
+	 * not atomic, so the copy in here is created on the caller's loop and
+	 * only ever settled or destroyed there: settling moves it into a task
+	 * dispatched to the loop, and a task dropped before it runs sends it
+	 * home rejected with std::errc::operation_canceled. The caller's loop
+	 * must outlive the task.
+	 */
+
+	template< class Result >
+	class pending
+	{
+	public:
+
+		pending( runloop &loop, promise< Result > ret )
+		:
+			m_loop( loop ),
+			m_ret( std::make_shared< promise< Result > >( std::move( ret ) ) )
+		{
+		}
+
+		pending( const pending& ) = delete;
+		pending& operator=( const pending& ) = delete;
+
+		~pending()
+		{
+			if ( m_ret )
+			{
+				reject( make_error_code( std::errc::operation_canceled ) );
+			}
+		}
+
+		void
+		resolve()
+		{
+			m_loop.dispatch( [ret = std::move( m_ret )]()
+			{
+				ret->resolve();
+			} );
+		}
+
+		template< class Value >
+		void
+		resolve( Value &&val )
+		{
+			// dispatch() takes a std::function, so a move-only result
+			// travels in shared storage rather than in the capture
+
+			auto value = std::make_shared< std::decay_t< Value > >( std::forward< Value >( val ) );
+
+			m_loop.dispatch( [ret = std::move( m_ret ), value = std::move( value )]()
+			{
+				ret->resolve( std::move( *value ) );
+			} );
+		}
+
+		void
+		reject( std::error_code err )
+		{
+			// resolve() hands the promise over before dispatch() can fail, so
+			// if that threw there is nothing left here to reject
+
+			if ( !m_ret )
+			{
+				return;
+			}
+
+			m_loop.dispatch( [ret = std::move( m_ret ), err]()
+			{
+				ret->reject( err );
+			} );
+		}
+
+		void
+		abandon()
+		{
+			m_ret.reset();
+		}
+
+	private:
+
+		runloop								&m_loop;
+		std::shared_ptr< promise< Result > >	m_ret;
+	};
+
+	template< class Result, class Func >
+	static void
+	deliver( pending< Result > &out, Func &func )
+	{
+		try
+		{
+			if constexpr ( std::is_void< Result >::value )
+			{
+				func();
+				out.resolve();
+			}
+			else
+			{
+				out.resolve( func() );
+			}
+		}
+		catch ( const std::system_error &exc )
+		{
+			out.reject( exc.code() );
+		}
+		catch ( ... )
+		{
+			out.reject( make_error_code( std::errc::state_not_recoverable ) );
+		}
+	}
+
+	bool
+	try_push( worker &w, task_f &task );
+
+	bool
+	try_pop( worker &w, task_f &task );
+
+	bool
+	try_steal( std::size_t self, task_f &task );
+
+	void
+	run( std::size_t self );
+
+	std::vector< std::unique_ptr< worker > >	m_workers;
+	std::size_t									m_queue_depth;
+	std::atomic< std::size_t >					m_next;
+	std::atomic< std::size_t >					m_pending;
+	std::mutex									m_sleep_mutex;
+	std::condition_variable						m_wakeup;
+	bool										m_stopping;
+};
+
+}
+
+#endif
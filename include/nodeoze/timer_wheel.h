@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2013-2017, Collobos Software Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+ 
+
+#ifndef _nodeoze_timer_wheel_h
+#define _nodeoze_timer_wheel_h
+
+#include <nodeoze/runloop.h>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+
+namespace nodeoze {
+
+/*
+ * A hierarchical timer wheel: five levels of 64 slots with a 1 ms tick,
+ * covering about twelve days before deadlines are clamped and re-cascaded.
+ * schedule() and cancel() are O(1) and allocate nothing once the entry free
+ * list is warm, which suits large numbers of timers that are usually
+ * cancelled before they fire (promise timeouts, request expiry, idle
+ * connection reaping).
+ *
+ * All the timers on a wheel share a single runloop timer, armed for the next
+ * occupied tick, or when none is near, for the first cascade that brings a
+ * timer down from the upper levels. It is suspended while the wheel is empty.
+ *
+ * Every runloop has one, see runloop::timers(). A wheel is not thread safe,
+ * use it only on its runloop's thread.
+ */
+
+class timer_wheel
+{
+public:
+
+	typedef void *timer;
+	typedef std::function< void ( void ) > expire_f;
+
+	explicit timer_wheel( runloop &loop );
+
+	timer_wheel( const timer_wheel& ) = delete;
+	timer_wheel& operator=( const timer_wheel& ) = delete;
+
+	~timer_wheel();
+
+	/*
+	 * Calls func once, no earlier than timeout from now. The returned timer
+	 * is valid until func is called or the timer is cancelled.
+	 */
+
+	timer
+	schedule( std::chrono::milliseconds timeout, expire_f func );
+
+	/*
+	 * Cancels a pending timer on whichever wheel it was scheduled on.
+	 */
+
+	static void
+	cancel( timer t );
+
+	inline std::size_t
+	size() const
+	{
+		return m_count;
+	}
+
+	/*
+	 * Whether the runloop timer is running; it is not while the wheel is empty.
+	 */
+
+	inline bool
+	armed() const
+	{
+		return m_running;
+	}
+
+private:
+
+	static const std::uint32_t	slot_bits	= 6;
+	static const std::uint32_t	slots		= 1 << slot_bits;
+	static const std::uint32_t	slot_mask	= slots - 1;
+	static const std::uint32_t	levels		= 5;
+
+	struct link
+	{
+		link	*m_prev;
+		link	*m_next;
+	};
+
+	struct entry : public link
+	{
+		timer_wheel		*m_wheel;
+		std::uint64_t	m_expires;
+		expire_f		m_func;
+	};
+
+	static void
+	init( link &head );
+
+	static bool
+	empty( const link &head );
+
+	static void
+	unlink( link *l );
+
+	static void
+	append( link &head, link *l );
+
+	static void
+	splice( link &from, link &to );
+
+	std::uint64_t
+	now() const;
+
+	void
+	insert( entry *e );
+
+	void
+	cascade( std::uint32_t level, std::uint32_t index );
+
+	void
+	advance( std::uint64_t target );
+
+	void
+	rearm();
+
+	std::uint64_t
+	next_expiry() const;
+
+	void
+	recycle( entry *e );
+
+	runloop									&m_loop;
+	runloop::event							m_event;
+	std::chrono::steady_clock::time_point	m_base;
+	std::uint64_t							m_now;
+	std::uint64_t							m_armed;
+	std::size_t								m_count;
+	bool									m_advancing;
+	bool									m_running;
+	link									m_slots[ levels ][ slots ];
+	entry									*m_free;
+};
+
+}
+
+#endif
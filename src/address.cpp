@@ -86,6 +86,8 @@ ip::address::resolve( std::string host )
 	promise< std::vector< ip::address > > ret;
 
 	assert( host.size() > 0 );
+
+	auto loop = &runloop::current();	// resolve on the caller's runloop
 	
 	std::thread t( [=]()
 	{
@@ -129,7 +131,7 @@ ip::address::resolve( std::string host )
 			freeaddrinfo( result );
 		}
 
-		runloop::shared().dispatch( [=]() mutable
+		loop->dispatch( [=]() mutable
 		{
 			switch ( err )
 			{
@@ -0,0 +1,476 @@
+#include <nodeoze/bstream/bview.h>
+#include <cstring>
+
+using namespace nodeoze;
+using namespace bstream;
+
+namespace
+{
+
+template< class U >
+U
+load_num( const byte_type* p, bool reverse )
+{
+    U value;
+    ::memcpy( &value, p, sizeof( U ) );
+    return reverse ? bend::endian_reverse( value ) : value;
+}
+
+} // anonymous namespace
+
+bview::kind
+bview::get_kind() const noexcept
+{
+    std::error_code err;
+    auto hdr = read_header( m_begin, err );
+    return err ? kind::invalid : hdr.k;
+}
+
+bview::header
+bview::read_header( std::size_t pos, std::error_code& err ) const
+{
+    clear_error( err );
+    header result{ kind::invalid, 0, 0 };
+    std::size_t available = ( pos < m_end ) ? m_end - pos : 0;
+    const byte_type* p = m_buf.data() + pos;
+    bool reverse = false;
+    typecode::type tcode = 0;
+
+    auto need = [&] ( std::size_t n )
+    {
+        if ( available < n )
+        {
+            err = make_error_code( bstream::errc::read_past_end_of_stream );
+            return false;
+        }
+        return true;
+    };
+
+    if ( ! m_context )
+    {
+        err = make_error_code( bstream::errc::invalid_state );
+        goto exit;
+    }
+
+    if ( ! need( 1 ) ) goto exit;
+
+    reverse = reverse_order();
+    tcode = *p;
+
+    if ( tcode <= typecode::positive_fixint_max || tcode >= typecode::negative_fixint_min )
+    {
+        result = header{ kind::integer, 1, 0 };
+    }
+    else if ( tcode <= typecode::fixmap_max )
+    {
+        result = header{ kind::map, 1, static_cast< std::size_t >( tcode & 0x0f ) };
+    }
+    else if ( tcode <= typecode::fixarray_max )
+    {
+        result = header{ kind::array, 1, static_cast< std::size_t >( tcode & 0x0f ) };
+    }
+    else if ( tcode <= typecode::fixstr_max )
+    {
+        result = header{ kind::string, 1, static_cast< std::size_t >( tcode & 0x1f ) };
+    }
+    else
+    {
+        switch ( tcode )
+        {
+            case typecode::nil:
+                result = header{ kind::nil, 1, 0 };
+                break;
+
+            case typecode::bool_false:
+            case typecode::bool_true:
+                result = header{ kind::boolean, 1, 0 };
+                break;
+
+            case typecode::uint_8:
+            case typecode::int_8:
+                result = header{ kind::integer, 2, 0 };
+                break;
+
+            case typecode::uint_16:
+            case typecode::int_16:
+                result = header{ kind::integer, 3, 0 };
+                break;
+
+            case typecode::uint_32:
+            case typecode::int_32:
+                result = header{ kind::integer, 5, 0 };
+                break;
+
+            case typecode::uint_64:
+            case typecode::int_64:
+                result = header{ kind::integer, 9, 0 };
+                break;
+
+            case typecode::float_32:
+                result = header{ kind::floating, 5, 0 };
+                break;
+
+            case typecode::float_64:
+                result = header{ kind::floating, 9, 0 };
+                break;
+
+            case typecode::str_8:
+            case typecode::bin_8:
+                if ( ! need( 2 ) ) goto exit;
+                result = header{ typecode::is_string( tcode ) ? kind::string : kind::blob, 2, p[ 1 ] };
+                break;
+
+            case typecode::str_16:
+            case typecode::bin_16:
+                if ( ! need( 3 ) ) goto exit;
+                result = header{ typecode::is_string( tcode ) ? kind::string : kind::blob, 3, load_num< std::uint16_t >( p + 1, reverse ) };
+                break;
+
+            case typecode::str_32:
+            case typecode::bin_32:
+                if ( ! need( 5 ) ) goto exit;
+                result = header{ typecode::is_string( tcode ) ? kind::string : kind::blob, 5, load_num< std::uint32_t >( p + 1, reverse ) };
+                break;
+
+            case typecode::array_16:
+                if ( ! need( 3 ) ) goto exit;
+                result = header{ kind::array, 3, load_num< std::uint16_t >( p + 1, reverse ) };
+                break;
+
+            case typecode::array_32:
+                if ( ! need( 5 ) ) goto exit;
+                result = header{ kind::array, 5, load_num< std::uint32_t >( p + 1, reverse ) };
+                break;
+
+            case typecode::map_16:
+                if ( ! need( 3 ) ) goto exit;
+                result = header{ kind::map, 3, load_num< std::uint16_t >( p + 1, reverse ) };
+                break;
+
+            case typecode::map_32:
+                if ( ! need( 5 ) ) goto exit;
+                result = header{ kind::map, 5, load_num< std::uint32_t >( p + 1, reverse ) };
+                break;
+
+            case typecode::fixext_1:
+                result = header{ kind::ext, 2, 1 };
+                break;
+
+            case typecode::fixext_2:
+                result = header{ kind::ext, 2, 2 };
+                break;
+
+            case typecode::fixext_4:
+                result = header{ kind::ext, 2, 4 };
+                break;
+
+            case typecode::fixext_8:
+                result = header{ kind::ext, 2, 8 };
+                break;
+
+            case typecode::fixext_16:
+                result = header{ kind::ext, 2, 16 };
+                break;
+
+            case typecode::ext_8:
+                if ( ! need( 3 ) ) goto exit;
+                result = header{ kind::ext, 3, p[ 1 ] };
+                break;
+
+            case typecode::ext_16:
+                if ( ! need( 4 ) ) goto exit;
+                result = header{ kind::ext, 4, load_num< std::uint16_t >( p + 1, reverse ) };
+                break;
+
+            case typecode::ext_32:
+                if ( ! need( 6 ) ) goto exit;
+                result = header{ kind::ext, 6, load_num< std::uint32_t >( p + 1, reverse ) };
+                break;
+
+            default:
+                err = make_error_code( bstream::errc::type_error );
+                goto exit;
+        }
+    }
+
+    if ( ! need( result.header_size ) ) goto exit;
+
+exit:
+    return result;
+}
+
+std::size_t
+bview::skip( std::size_t pos, std::error_code& err ) const
+{
+    clear_error( err );
+
+    // iterative rather than recursive, so deeply nested input cannot exhaust the stack
+
+    std::size_t pending = 1;
+    while ( pending > 0 )
+    {
+        auto hdr = read_header( pos, err );
+        if ( err ) goto exit;
+
+        pos += hdr.header_size;
+        --pending;
+
+        switch ( hdr.k )
+        {
+            case kind::array:
+                pending += hdr.count;
+                break;
+
+            case kind::map:
+                pending += 2 * hdr.count;
+                break;
+
+            case kind::string:
+            case kind::blob:
+            case kind::ext:
+                if ( m_end - pos < hdr.count )
+                {
+                    err = make_error_code( bstream::errc::read_past_end_of_stream );
+                    goto exit;
+                }
+                pos += hdr.count;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+exit:
+    return pos;
+}
+
+std::size_t
+bview::size( std::error_code& err ) const
+{
+    auto hdr = read_header( m_begin, err );
+    return err ? 0 : hdr.count;
+}
+
+std::size_t
+bview::size() const
+{
+    std::error_code err;
+    auto result = size( err );
+    if ( err )
+    {
+        throw std::system_error{ err };
+    }
+    return result;
+}
+
+bview
+bview::at( std::size_t index, std::error_code& err ) const
+{
+    bview result;
+    std::size_t pos = 0;
+
+    auto hdr = read_header( m_begin, err );
+    if ( err ) goto exit;
+
+    if ( hdr.k != kind::array )
+    {
+        err = make_error_code( bstream::errc::type_error );
+        goto exit;
+    }
+
+    if ( index >= hdr.count )
+    {
+        err = make_error_code( std::errc::result_out_of_range );
+        goto exit;
+    }
+
+    pos = m_begin + hdr.header_size;
+    for ( auto i = 0u; i < index; ++i )
+    {
+        pos = skip( pos, err );
+        if ( err ) goto exit;
+    }
+
+    result = bview{ m_buf, pos, m_end, m_context };
+
+exit:
+    return result;
+}
+
+bview
+bview::at( std::size_t index ) const
+{
+    std::error_code err;
+    auto result = at( index, err );
+    if ( err )
+    {
+        throw std::system_error{ err };
+    }
+    return result;
+}
+
+bview
+bview::find( std::string_view key, std::error_code& err ) const
+{
+    bview result;
+    std::size_t pos = 0;
+
+    auto hdr = read_header( m_begin, err );
+    if ( err ) goto exit;
+
+    if ( hdr.k != kind::map )
+    {
+        err = make_error_code( bstream::errc::type_error );
+        goto exit;
+    }
+
+    pos = m_begin + hdr.header_size;
+    for ( auto i = 0u; i < hdr.count; ++i )
+    {
+        auto key_hdr = read_header( pos, err );
+        if ( err ) goto exit;
+
+        if ( key_hdr.k == kind::string && key_hdr.count == key.size() )
+        {
+            auto key_start = pos + key_hdr.header_size;
+            if ( m_end - key_start < key_hdr.count )
+            {
+                err = make_error_code( bstream::errc::read_past_end_of_stream );
+                goto exit;
+            }
+            if ( ::memcmp( m_buf.data() + key_start, key.data(), key.size() ) == 0 )
+            {
+                result = bview{ m_buf, key_start + key_hdr.count, m_end, m_context };
+                goto exit;
+            }
+        }
+
+        pos = skip( pos, err );     // key
+        if ( err ) goto exit;
+
+        pos = skip( pos, err );     // value
+        if ( err ) goto exit;
+    }
+
+exit:
+    return result;
+}
+
+bview
+bview::find( std::string_view key ) const
+{
+    std::error_code err;
+    auto result = find( key, err );
+    if ( err )
+    {
+        throw std::system_error{ err };
+    }
+    return result;
+}
+
+std::string_view
+bview::string_view( std::error_code& err ) const
+{
+    std::string_view result;
+    std::size_t start = 0;
+
+    auto hdr = read_header( m_begin, err );
+    if ( err ) goto exit;
+
+    if ( hdr.k != kind::string )
+    {
+        err = make_error_code( bstream::errc::type_error );
+        goto exit;
+    }
+
+    start = m_begin + hdr.header_size;
+    if ( m_end - start < hdr.count )
+    {
+        err = make_error_code( bstream::errc::read_past_end_of_stream );
+        goto exit;
+    }
+
+    result = std::string_view{ reinterpret_cast< const char* >( m_buf.data() + start ), hdr.count };
+
+exit:
+    return result;
+}
+
+std::string_view
+bview::string_view() const
+{
+    std::error_code err;
+    auto result = string_view( err );
+    if ( err )
+    {
+        throw std::system_error{ err };
+    }
+    return result;
+}
+
+buffer
+bview::blob( std::error_code& err ) const
+{
+    buffer result;
+    std::size_t start = 0;
+
+    auto hdr = read_header( m_begin, err );
+    if ( err ) goto exit;
+
+    if ( hdr.k != kind::blob )
+    {
+        err = make_error_code( bstream::errc::type_error );
+        goto exit;
+    }
+
+    start = m_begin + hdr.header_size;
+    if ( m_end - start < hdr.count )
+    {
+        err = make_error_code( bstream::errc::read_past_end_of_stream );
+        goto exit;
+    }
+
+    result = m_buf.slice( start, hdr.count );
+
+exit:
+    return result;
+}
+
+buffer
+bview::blob() const
+{
+    std::error_code err;
+    auto result = blob( err );
+    if ( err )
+    {
+        throw std::system_error{ err };
+    }
+    return result;
+}
+
+buffer
+bview::encoded( std::error_code& err ) const
+{
+    buffer result;
+
+    auto end = skip( m_begin, err );
+    if ( err ) goto exit;
+
+    result = m_buf.slice( m_begin, end - m_begin );
+
+exit:
+    return result;
+}
+
+buffer
+bview::encoded() const
+{
+    std::error_code err;
+    auto result = encoded( err );
+    if ( err )
+    {
+        throw std::system_error{ err };
+    }
+    return result;
+}
@@ -0,0 +1,232 @@
+#include <nodeoze/bstream/ibcompressbuf.h>
+
+#define MINIZ_HEADER_FILE_ONLY
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include "../miniz.c"
+
+using namespace nodeoze;
+using namespace bstream;
+
+namespace
+{
+
+std::error_code
+make_zerror( int status )
+{
+    switch ( status )
+    {
+        case MZ_MEM_ERROR:
+            return make_error_code( std::errc::not_enough_memory );
+        case MZ_DATA_ERROR:
+            return make_error_code( std::errc::bad_message );
+        case MZ_PARAM_ERROR:
+            return make_error_code( std::errc::invalid_argument );
+        default:
+            return make_error_code( bstream::errc::invalid_state );
+    }
+}
+
+} // anonymous namespace
+
+struct ibcompressbuf::zstate
+{
+    zstate()
+    {
+        ::memset( &stream, 0, sizeof( stream ) );
+    }
+
+    mz_stream   stream;
+    bool        initialized = false;
+};
+
+ibcompressbuf::ibcompressbuf( std::unique_ptr< ibstreambuf > source, std::error_code& err, size_type buffer_size )
+:
+ibstreambuf{},
+m_source{ std::move( source ) },
+m_data( buffer_size ),
+m_zdata( buffer_size ),
+m_zstate{ std::make_unique< zstate >() },
+m_at_end{ false }
+{
+    reset_ptrs();
+    init( err );
+}
+
+ibcompressbuf::ibcompressbuf( std::unique_ptr< ibstreambuf > source, size_type buffer_size )
+:
+ibstreambuf{},
+m_source{ std::move( source ) },
+m_data( buffer_size ),
+m_zdata( buffer_size ),
+m_zstate{ std::make_unique< zstate >() },
+m_at_end{ false }
+{
+    reset_ptrs();
+    std::error_code err;
+    init( err );
+    if ( err )
+    {
+        throw std::system_error{ err };
+    }
+}
+
+ibcompressbuf::~ibcompressbuf()
+{
+    if ( m_zstate->initialized )
+    {
+        mz_inflateEnd( &m_zstate->stream );
+    }
+}
+
+void
+ibcompressbuf::init( std::error_code& err )
+{
+    clear_error( err );
+
+    if ( ! m_source )
+    {
+        err = make_error_code( std::errc::invalid_argument );
+        goto exit;
+    }
+
+    {
+        auto status = mz_inflateInit( &m_zstate->stream );
+        if ( status != MZ_OK )
+        {
+            err = make_zerror( status );
+            goto exit;
+        }
+        m_zstate->initialized = true;
+    }
+
+exit:
+    return;
+}
+
+size_type
+ibcompressbuf::really_underflow( std::error_code& err )
+{
+    clear_error( err );
+    assert( gnext() == gend() );
+    auto& strm = m_zstate->stream;
+    size_type produced = 0;
+
+    gbase_offset( gpos() );
+    reset_ptrs();
+
+    while ( ! m_at_end && produced == 0 )
+    {
+        bool source_exhausted = false;
+        if ( strm.avail_in == 0 )
+        {
+            auto got = m_source->getn( m_zdata.data(), m_zdata.size(), err );
+            if ( err ) goto exit;
+            strm.next_in = m_zdata.data();
+            strm.avail_in = static_cast< unsigned int >( got );
+            source_exhausted = ( got == 0 );
+        }
+
+        strm.next_out = m_data.data();
+        strm.avail_out = static_cast< unsigned int >( m_data.size() );
+
+        auto status = mz_inflate( &strm, MZ_NO_FLUSH );
+        produced = m_data.size() - strm.avail_out;
+
+        if ( status == MZ_STREAM_END )
+        {
+            m_at_end = true;
+        }
+        else if ( status == MZ_BUF_ERROR && source_exhausted )
+        {
+            // the source ended before the compressed stream did
+            err = make_error_code( bstream::errc::read_past_end_of_stream );
+            produced = 0;
+            goto exit;
+        }
+        else if ( status != MZ_OK && status != MZ_BUF_ERROR )
+        {
+            err = make_zerror( status );
+            produced = 0;
+            goto exit;
+        }
+    }
+
+    gend( gbase() + produced );
+
+exit:
+    return produced;
+}
+
+position_type
+ibcompressbuf::really_seek( seek_anchor where, offset_type offset, std::error_code& err )
+{
+    clear_error( err );
+    position_type result = invalid_position;
+
+    switch ( where )
+    {
+        case seek_anchor::current:
+        {
+            result = gpos() + offset;
+        }
+        break;
+
+        case seek_anchor::end:
+        {
+            err = make_error_code( std::errc::invalid_seek );
+            goto exit;
+        }
+        break;
+
+        case seek_anchor::begin:
+        {
+            result = offset;
+        }
+        break;
+    }
+
+    // only the decompressed window currently held in the get area is reachable
+
+    if ( result < gbase_offset() || result > gbase_offset() + ( gend() - gbase() ) )
+    {
+        err = make_error_code( std::errc::invalid_seek );
+        result = invalid_position;
+        goto exit;
+    }
+
+    gnext( gbase() + ( result - gbase_offset() ) );
+
+exit:
+    return result;
+}
+
+position_type
+ibcompressbuf::really_tell( seek_anchor where, std::error_code& err )
+{
+    clear_error( err );
+    position_type result = invalid_position;
+
+    switch ( where )
+    {
+        case seek_anchor::current:
+        {
+            result = gpos();
+        }
+        break;
+
+        case seek_anchor::end:
+        {
+            // unknown without decompressing the remainder of the stream
+            err = make_error_code( std::errc::invalid_seek );
+        }
+        break;
+
+        case seek_anchor::begin:
+        {
+            result = 0;
+        }
+        break;
+    }
+
+    return result;
+}
@@ -1,10 +1,11 @@
 #include <nodeoze/bstream/ibmembuf.h>
+#include <nodeoze/bstream/error.h>
 
 using namespace nodeoze;
 using namespace bstream;
 
 buffer
-ibmembuf::get_slice( size_type n )
+ibmembuf::slice_available( size_type n )
 {
     size_type available = static_cast< size_type >( gend() - gnext() );
     size_type slice_size = std::min( available, n );
@@ -15,20 +16,44 @@ ibmembuf::get_slice( size_type n )
     else
     {
         auto pos = gpos();
-        gbump( n );
-        return m_buf.slice( pos, n );
+        gbump( slice_size );
+        return m_buf.slice( pos, slice_size );
     }
 }
 
+buffer
+ibmembuf::really_get_slice( size_type n, std::error_code& err )
+{
+    clear_error( err );
+    buffer result;
+
+    if ( m_buf.is_exclusive() )
+    {
+        err = make_error_code( bstream::errc::ibstreambuf_not_shareable );
+        goto exit;
+    }
+
+    if ( static_cast< size_type >( gend() - gnext() ) < n )
+    {
+        err = make_error_code( bstream::errc::read_past_end_of_stream );
+        goto exit;
+    }
+
+    result = slice_available( n );
+
+exit:
+    return result;
+}
+
 buffer
 ibmembuf::getn( size_type n, std::error_code& err )
 {
     clear_error( err );
-    return get_slice( n );
+    return slice_available( n );
 }
 
 buffer
 ibmembuf::getn( size_type n )
 {
-    return get_slice( n );
+    return slice_available( n );
 }
@@ -563,6 +563,34 @@ ibstream::read_blob( std::error_code& ec )
 	}
 }
 
+buffer
+ibstream::read_blob_view( std::error_code& ec )
+{
+	auto nbytes = read_blob_header( ec );
+	if ( ec )
+	{
+		return buffer{};
+	}
+	else
+	{
+		return get_slice( nbytes, ec );
+	}
+}
+
+string_alias
+ibstream::read_string_view( std::error_code& ec )
+{
+	auto nbytes = read_string_header( ec );
+	if ( ec )
+	{
+		return string_alias{};
+	}
+	else
+	{
+		return string_alias{ get_slice( nbytes, ec ) };
+	}
+}
+
 std::size_t
 ibstream::read_ext_header( std::uint8_t& ext_type )
 {
@@ -234,6 +234,25 @@ ibstreambuf::getn( byte_type* dst, size_type n )
     return n - remaining; 
 }
 
+buffer
+ibstreambuf::really_get_slice( size_type /* n */, std::error_code& err )
+{
+    err = make_error_code( bstream::errc::ibstreambuf_not_shareable );
+    return buffer{};
+}
+
+buffer
+ibstreambuf::get_slice( size_type n )
+{
+    std::error_code err;
+    auto result = really_get_slice( n, err );
+    if ( err )
+    {
+        throw std::system_error{ err };
+    }
+    return result;
+}
+
 position_type
 ibstreambuf::seek( position_type position )
 {
@@ -0,0 +1,256 @@
+#include <nodeoze/bstream/obcompressbuf.h>
+
+#define MINIZ_HEADER_FILE_ONLY
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include "../miniz.c"
+
+using namespace nodeoze;
+using namespace bstream;
+
+namespace
+{
+
+std::error_code
+make_zerror( int status )
+{
+    switch ( status )
+    {
+        case MZ_MEM_ERROR:
+            return make_error_code( std::errc::not_enough_memory );
+        case MZ_PARAM_ERROR:
+            return make_error_code( std::errc::invalid_argument );
+        default:
+            return make_error_code( bstream::errc::invalid_state );
+    }
+}
+
+} // anonymous namespace
+
+struct obcompressbuf::zstate
+{
+    zstate()
+    {
+        ::memset( &stream, 0, sizeof( stream ) );
+    }
+
+    mz_stream   stream;
+    bool        initialized = false;
+};
+
+obcompressbuf::obcompressbuf( std::unique_ptr< obstreambuf > sink, std::error_code& err, int level, size_type buffer_size )
+:
+obstreambuf{},
+m_sink{ std::move( sink ) },
+m_data( buffer_size ),
+m_zdata( buffer_size ),
+m_zstate{ std::make_unique< zstate >() },
+m_finished{ false }
+{
+    reset_ptrs();
+    init( level, err );
+}
+
+obcompressbuf::obcompressbuf( std::unique_ptr< obstreambuf > sink, int level, size_type buffer_size )
+:
+obstreambuf{},
+m_sink{ std::move( sink ) },
+m_data( buffer_size ),
+m_zdata( buffer_size ),
+m_zstate{ std::make_unique< zstate >() },
+m_finished{ false }
+{
+    reset_ptrs();
+    std::error_code err;
+    init( level, err );
+    if ( err )
+    {
+        throw std::system_error{ err };
+    }
+}
+
+obcompressbuf::~obcompressbuf()
+{
+    if ( m_zstate->initialized )
+    {
+        std::error_code err;
+        finish( err );
+        mz_deflateEnd( &m_zstate->stream );
+    }
+}
+
+void
+obcompressbuf::init( int level, std::error_code& err )
+{
+    clear_error( err );
+
+    if ( ! m_sink || level < no_compression || level > best_compression )
+    {
+        err = make_error_code( std::errc::invalid_argument );
+        goto exit;
+    }
+
+    {
+        auto status = mz_deflateInit( &m_zstate->stream, level );
+        if ( status != MZ_OK )
+        {
+            err = make_zerror( status );
+            goto exit;
+        }
+        m_zstate->initialized = true;
+    }
+
+exit:
+    return;
+}
+
+void
+obcompressbuf::compress( const byte_type* src, size_type n, bool finish, std::error_code& err )
+{
+    clear_error( err );
+    auto& strm = m_zstate->stream;
+    strm.next_in = src;
+    strm.avail_in = static_cast< unsigned int >( n );
+
+    while ( true )
+    {
+        strm.next_out = m_zdata.data();
+        strm.avail_out = static_cast< unsigned int >( m_zdata.size() );
+
+        auto status = mz_deflate( &strm, finish ? MZ_FINISH : MZ_NO_FLUSH );
+        if ( status != MZ_OK && status != MZ_STREAM_END && status != MZ_BUF_ERROR )
+        {
+            err = make_zerror( status );
+            goto exit;
+        }
+
+        size_type produced = m_zdata.size() - strm.avail_out;
+        if ( produced > 0 )
+        {
+            m_sink->putn( m_zdata.data(), produced, err );
+            if ( err ) goto exit;
+        }
+
+        // deflate is done with this chunk once it no longer fills the output buffer
+
+        if ( finish ? ( status == MZ_STREAM_END ) : ( strm.avail_in == 0 && strm.avail_out > 0 ) )
+        {
+            break;
+        }
+    }
+
+exit:
+    return;
+}
+
+void
+obcompressbuf::finish( std::error_code& err )
+{
+    clear_error( err );
+
+    if ( m_finished ) goto exit;
+
+    flush( err );
+    if ( err ) goto exit;
+
+    compress( nullptr, 0, true, err );
+    if ( err ) goto exit;
+
+    m_sink->flush( err );
+    if ( err ) goto exit;
+
+    m_finished = true;
+
+exit:
+    return;
+}
+
+void
+obcompressbuf::finish()
+{
+    std::error_code err;
+    finish( err );
+    if ( err )
+    {
+        throw std::system_error{ err };
+    }
+}
+
+void
+obcompressbuf::really_flush( std::error_code& err )
+{
+    clear_error( err );
+    auto pos = ppos();
+    assert( dirty() && pnext() > dirty_start() );
+
+    if ( m_finished )
+    {
+        err = make_error_code( bstream::errc::invalid_state );
+        goto exit;
+    }
+
+    compress( pbase(), static_cast< size_type >( pnext() - pbase() ), false, err );
+    if ( err ) goto exit;
+
+    pbase_offset( pos );
+    pnext( pbase() );
+
+exit:
+    return;
+}
+
+void
+obcompressbuf::really_touch( std::error_code& err )
+{
+    clear_error( err );
+    last_touched( ppos() );
+}
+
+position_type
+obcompressbuf::really_seek( seek_anchor where, offset_type offset, std::error_code& err )
+{
+    clear_error( err );
+    position_type result = invalid_position;
+
+    flush( err );
+    if ( err ) goto exit;
+
+    switch ( where )
+    {
+        case seek_anchor::current:
+        {
+            result = ppos() + offset;
+        }
+        break;
+
+        case seek_anchor::end:
+        {
+            result = get_high_watermark() + offset;
+        }
+        break;
+
+        case seek_anchor::begin:
+        {
+            result = offset;
+        }
+        break;
+    }
+
+    // compressed output can't be rewritten; only a no-op seek is possible
+
+    if ( result != ppos() )
+    {
+        err = make_error_code( std::errc::invalid_seek );
+        result = invalid_position;
+        goto exit;
+    }
+
+exit:
+    return result;
+}
+
+void
+obcompressbuf::really_overflow( size_type, std::error_code& err )
+{
+    clear_error( err );
+    assert( pbase_offset() == ppos() && pnext() == pbase() );
+}
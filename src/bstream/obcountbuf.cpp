@@ -0,0 +1,84 @@
+#include <nodeoze/bstream/obcountbuf.h>
+
+using namespace nodeoze;
+using namespace bstream;
+
+obcountbuf&
+obcountbuf::clear() noexcept
+{
+    pbase_offset( 0 );
+    reset_ptrs();
+    reset_high_water_mark();
+    last_touched( 0UL );
+    dirty( false );
+    return *this;
+}
+
+void
+obcountbuf::really_flush( std::error_code& err )
+{
+    clear_error( err );
+    assert( dirty() && pnext() > dirty_start() );
+    auto pos = ppos();
+    pbase_offset( pos );
+    pnext( pbase() );
+}
+
+void
+obcountbuf::really_touch( std::error_code& err )
+{
+    clear_error( err );
+    last_touched( ppos() );
+}
+
+position_type
+obcountbuf::really_seek( seek_anchor where, offset_type offset, std::error_code& err )
+{
+    clear_error( err );
+    position_type result = invalid_position;
+
+    flush( err );
+    if ( err ) goto exit;
+
+    switch ( where )
+    {
+        case seek_anchor::current:
+        {
+            result = ppos() + offset;
+        }
+        break;
+
+        case seek_anchor::end:
+        {
+            auto end_pos = get_high_watermark();
+            result = end_pos + offset;
+        }
+        break;
+
+        case seek_anchor::begin:
+        {
+            result = offset;
+        }
+        break;
+    }
+
+    if ( result < 0 )
+    {
+        err = make_error_code( std::errc::invalid_argument );
+        result = invalid_position;
+        goto exit;
+    }
+
+    pbase_offset( result );
+    pnext( pbase() );
+
+exit:
+    return result;
+}
+
+void
+obcountbuf::really_overflow( size_type, std::error_code& err )
+{
+    clear_error( err );
+    assert( pbase_offset() == ppos() && pnext() == pbase() );
+}
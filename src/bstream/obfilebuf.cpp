@@ -1,9 +1,249 @@
 #include <nodeoze/bstream/obfilebuf.h>
 #include <unistd.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 
 using namespace nodeoze;
 using namespace bstream;
 
+/*
+ * Owns the I/O thread used by obfilebuf in async mode. Buffers circulate
+ * between the producer (one buffer being filled), the queue, and a spare
+ * list; the spare list running dry is what throttles the producer.
+ */
+
+class obfilebuf::async_writer
+{
+public:
+
+    async_writer( std::size_t buffer_count, size_type buffer_size )
+    :
+    m_spares{},
+    m_queue{},
+    m_busy{ false },
+    m_stopping{ false },
+    m_err{}
+    {
+        for ( auto i = 1u; i < buffer_count; ++i )
+        {
+            m_spares.emplace_back( buffer_size );
+        }
+        m_thread = std::thread{ [this] () { run(); } };
+    }
+
+    ~async_writer()
+    {
+        {
+            std::lock_guard< std::mutex > lock{ m_mutex };
+            m_stopping = true;
+        }
+        m_work_available.notify_one();
+        m_thread.join();
+    }
+
+    /*
+     * Queues the first n bytes of data for writing at offset, and replaces
+     * data with a spare buffer of the same size.
+     */
+
+    void
+    submit( int fd, std::vector< byte_type >& data, size_type n, position_type offset, std::error_code& err )
+    {
+        clear_error( err );
+        std::unique_lock< std::mutex > lock{ m_mutex };
+        m_state_changed.wait( lock, [this] () { return ! m_spares.empty() || m_err; } );
+        if ( m_err )
+        {
+            err = take_error();
+            return;
+        }
+        m_queue.push_back( job{ fd, std::move( data ), n, offset } );
+        data = std::move( m_spares.back() );
+        m_spares.pop_back();
+        lock.unlock();
+        m_work_available.notify_one();
+    }
+
+    void
+    drain( std::error_code& err )
+    {
+        std::unique_lock< std::mutex > lock{ m_mutex };
+        m_state_changed.wait( lock, [this] () { return m_queue.empty() && ! m_busy; } );
+        err = take_error();
+    }
+
+private:
+
+    struct job
+    {
+        int                         fd;
+        std::vector< byte_type >    data;
+        size_type                   size;
+        position_type               offset;
+    };
+
+    std::error_code
+    take_error()
+    {
+        auto result = m_err;
+        m_err.clear();
+        return result;
+    }
+
+    static std::error_code
+    write_all( job const& j )
+    {
+        auto p = j.data.data();
+        auto remaining = j.size;
+        auto offset = j.offset;
+        while ( remaining > 0 )
+        {
+            auto result = ::pwrite( j.fd, p, remaining, offset );
+            if ( result < 0 )
+            {
+                if ( errno == EINTR ) continue;
+                return std::error_code{ errno, std::generic_category() };
+            }
+            p += result;
+            remaining -= static_cast< size_type >( result );
+            offset += result;
+        }
+        return std::error_code{};
+    }
+
+    void
+    run()
+    {
+        std::unique_lock< std::mutex > lock{ m_mutex };
+        while ( true )
+        {
+            m_work_available.wait( lock, [this] () { return ! m_queue.empty() || m_stopping; } );
+            if ( m_queue.empty() )
+            {
+                break;
+            }
+
+            auto j = std::move( m_queue.front() );
+            m_queue.pop_front();
+            m_busy = true;
+            lock.unlock();
+
+            auto err = write_all( j );
+
+            lock.lock();
+            if ( err && ! m_err )
+            {
+                m_err = err;
+            }
+            m_spares.push_back( std::move( j.data ) );
+            m_busy = false;
+            m_state_changed.notify_all();
+        }
+    }
+
+    std::mutex                              m_mutex;
+    std::condition_variable                 m_work_available;
+    std::condition_variable                 m_state_changed;
+    std::vector< std::vector< byte_type > > m_spares;
+    std::deque< job >                       m_queue;
+    bool                                    m_busy;
+    bool                                    m_stopping;
+    std::error_code                         m_err;
+    std::thread                             m_thread;
+};
+
+void
+obfilebuf::async_writer_deleter::operator()( async_writer* writer ) const
+{
+    delete writer;
+}
+
+obfilebuf::~obfilebuf()
+{
+    if ( m_writer )
+    {
+        std::error_code err;
+        m_writer->drain( err );
+    }
+}
+
+void
+obfilebuf::async( std::size_t buffer_count, std::error_code& err )
+{
+    clear_error( err );
+
+    if ( buffer_count < 2 )
+    {
+        err = make_error_code( std::errc::invalid_argument );
+        goto exit;
+    }
+
+    flush( err );
+    if ( err ) goto exit;
+
+    drain( err );
+    if ( err ) goto exit;
+
+    m_writer.reset( new async_writer{ buffer_count, m_data.size() } );
+
+exit:
+    return;
+}
+
+void
+obfilebuf::async( std::size_t buffer_count )
+{
+    std::error_code err;
+    async( buffer_count, err );
+    if ( err )
+    {
+        throw std::system_error{ err };
+    }
+}
+
+void
+obfilebuf::drain( std::error_code& err )
+{
+    clear_error( err );
+    if ( m_writer )
+    {
+        m_writer->drain( err );
+    }
+}
+
+void
+obfilebuf::sync( std::error_code& err )
+{
+    clear_error( err );
+
+    flush( err );
+    if ( err ) goto exit;
+
+    drain( err );
+    if ( err ) goto exit;
+
+    if ( ::fsync( m_fd ) < 0 )
+    {
+        err = std::error_code{ errno, std::generic_category() };
+    }
+
+exit:
+    return;
+}
+
+void
+obfilebuf::sync()
+{
+    std::error_code err;
+    sync( err );
+    if ( err )
+    {
+        throw std::system_error{ err };
+    }
+}
+
 bool
 obfilebuf::really_make_writable()
 {
@@ -17,6 +257,18 @@ obfilebuf::really_flush( std::error_code& err )
     auto pos = ppos();
     assert( dirty() && pnext() > dirty_start() );
     assert( dirty_start() == pbase() );
+
+    if ( m_writer )
+    {
+        // positional writes in the background; the file offset is never used
+
+        m_writer->submit( m_fd, m_data, static_cast< size_type >( pnext() - pbase() ), pbase_offset(), err );
+        if ( err ) goto exit;
+        pbase_offset( pos );
+        reset_ptrs();
+        goto exit;
+    }
+
     if ( last_touched() != pbase_offset() )
     {
         auto seek_result = ::lseek( m_fd, pbase_offset(), SEEK_SET );
@@ -52,11 +304,14 @@ obfilebuf::really_touch( std::error_code& err )
     assert( pbase_offset() == pos && pnext() == pbase() );
     assert( last_touched() != pos );
 
-    auto result = ::lseek( m_fd, pos, SEEK_SET );
-    if ( result < 0 )
+    if ( ! m_writer )
     {
-        err = std::error_code{ errno, std::generic_category() };
-        goto exit;
+        auto result = ::lseek( m_fd, pos, SEEK_SET );
+        if ( result < 0 )
+        {
+            err = std::error_code{ errno, std::generic_category() };
+            goto exit;
+        }
     }
     last_touched( pos );
     
@@ -122,6 +377,9 @@ obfilebuf::close( std::error_code& err )
     clear_error( err );
     flush( err );
     if ( err ) goto exit;
+
+    drain( err );
+    if ( err ) goto exit;
     
     {
         auto result = ::close( m_fd );
@@ -166,6 +424,9 @@ obfilebuf::truncate( std::error_code& err )
     flush( err );
     if ( err ) goto exit;
 
+    drain( err );
+    if ( err ) goto exit;
+
     {
         auto pos = ppos();
         assert( pos == pbase_offset() );
@@ -249,7 +249,7 @@ database::continuous_select( const std::string &columns, const std::string &tabl
 	{
 		if ( table == target )
 		{
-			runloop::shared().dispatch( [=]() mutable
+			runloop::current().next_tick( [=]() mutable
 			{
 				if ( check_stmt )
 				{
@@ -281,7 +281,7 @@ database::continuous_select( const std::string &columns, const std::string &tabl
 
 		if ( table == target )
 		{
-			runloop::shared().dispatch( [=]() mutable
+			runloop::current().next_tick( [=]() mutable
 			{
 				if ( check_stmt )
 				{
@@ -316,7 +316,7 @@ database::continuous_select( const std::string &columns, const std::string &tabl
 	{
 		if ( table == target )
 		{
-			runloop::shared().dispatch( [=]() mutable
+			runloop::current().next_tick( [=]() mutable
 			{
 				if ( check_stmt )
 				{
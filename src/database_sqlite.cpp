@@ -250,7 +250,7 @@ database::manager_impl::continuous_select( const std::string &columns, const std
 		nunused( before );
 		nunused( after );
 	
-		runloop::shared().dispatch( [=]() mutable
+		runloop::current().next_tick( [=]() mutable
 		{
 			auto stmt = statement_impl( check_stmt, false );
 
@@ -29,6 +29,7 @@
 #include <nodeoze/macros.h>
 #include <fstream>
 #include "error_libuv.h"
+#include "runloop_libuv.h"
 #include <uv.h>
 
 using namespace nodeoze;
@@ -79,7 +80,7 @@ public:
 		assert( !m_options.path().empty() );
 
 		auto err	= std::error_code();
-		auto ret	= uv_fs_open( uv_default_loop(), &m_open_req, m_options.path().c_str(), flags(), 0644, nullptr );
+		auto ret	= uv_fs_open( libuv::current_loop(), &m_open_req, m_options.path().c_str(), flags(), 0644, nullptr );
 
 		if ( ret < 0 )
 		{
@@ -100,7 +101,7 @@ protected:
 
 		uv_buf_t iov = { reinterpret_cast< char* >( b.data() ), b.size() };
 
-		uv_fs_write( uv_default_loop(), &m_write_req, m_open_req.result, &iov, 1, -1, on_write );
+		uv_fs_write( libuv::current_loop(), &m_write_req, m_open_req.result, &iov, 1, -1, on_write );
 
 		m_write_req.ptr = this;
 
@@ -132,6 +133,8 @@ protected:
 
 			self->emit( "error", err );
 		}
+
+		runloop::current().drain_microtasks();
 	}
 
 	options				m_options;
@@ -193,7 +196,7 @@ public:
 	{
 		assert( !m_options.path().empty() );
 		auto err = std::error_code();
-		auto ret = uv_fs_open( uv_default_loop(), &m_open_req, m_options.path().c_str(), O_RDONLY, 0644, nullptr );
+		auto ret = uv_fs_open( libuv::current_loop(), &m_open_req, m_options.path().c_str(), O_RDONLY, 0644, nullptr );
 
 		if ( ret < 0 )
 		{
@@ -231,7 +234,7 @@ protected:
 	really_really_read()
 	{
 		uv_buf_t iov = { reinterpret_cast< char* >( m_read_buf.data() ), m_read_buf.size() };
-		uv_fs_read( uv_default_loop(), &m_read_req, m_open_req.result, &iov, 1, -1, on_read );
+		uv_fs_read( libuv::current_loop(), &m_read_req, m_open_req.result, &iov, 1, -1, on_read );
 		m_read_req.ptr = this;
 	}
 
@@ -252,7 +255,7 @@ private:
 
 			self->push( self->m_read_buf );
 			//iov.len = req->result;
-			// uv_fs_write(uv_default_loop(), &write_req, 1, &iov, 1, -1, on_write);
+			// uv_fs_write(libuv::current_loop(), &write_req, 1, &iov, 1, -1, on_write);
 
 			if ( !self->m_paused )
 			{
@@ -261,7 +264,7 @@ private:
 		}
 		else if ( req->result == 0 )
 		{
-			uv_fs_close( uv_default_loop(), &self->m_close_req, self->m_open_req.result, nullptr );
+			uv_fs_close( libuv::current_loop(), &self->m_close_req, self->m_open_req.result, nullptr );
 
 			self->emit( "end" );
 		}
@@ -269,6 +272,8 @@ private:
 		{
 			self->emit( "error", std::error_code( req->result, libuv::error_category() ) );
 		}
+
+		runloop::current().drain_microtasks();
 	}
 
 	options				m_options;
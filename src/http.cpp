@@ -1679,7 +1679,7 @@ http::connection::maybe_invoke_reply( std::error_code error, http::message::ptr
 			saved.reject( error );
 		}
 	
-		runloop::shared().dispatch( [=]() mutable
+		runloop::current().next_tick( [=]() mutable
 		{
 			// it's safe to let it go here...
 			
@@ -28,11 +28,17 @@
 #include <nodeoze/test.h>
 #include "net_utils.h"
 #include "error_libuv.h"
+#include "runloop_libuv.h"
 #include <functional>
+#include <atomic>
 #include <queue>
 #include <errno.h>
 #include <uv.h>
 
+#if defined( __linux__ )
+#	include <sys/socket.h>
+#endif
+
 using namespace nodeoze;
 
 #if defined( WIN32 )
@@ -59,6 +65,214 @@ uv_tcp_open_stream(uv_tcp_t* handle, uv_os_sock_t sock)
 
 #endif
 
+#if defined( __APPLE__ )
+#	pragma mark recv_pool implementation
+#endif
+
+/*
+ * Receive buffers are carved from fixed size blocks, with one free list per
+ * power of two from 2K to 64K. A block is wrapped in the buffer that is
+ * pushed downstream and comes back here when the last reference to it is
+ * dropped, so a consumer that holds on to what it read costs neither a copy
+ * nor a reallocation.
+ *
+ * There is one runloop per thread, so the pool is thread local. A block
+ * released on some other thread goes back to the heap. The pool itself is
+ * reference counted by its thread and by every block it has handed out, so
+ * buffers may outlive the thread that read them.
+ */
+
+class recv_pool
+{
+public:
+
+	static constexpr std::size_t min_shift		= 11;
+	static constexpr std::size_t max_shift		= 16;
+	static constexpr std::size_t min_size		= std::size_t( 1 ) << min_shift;
+	static constexpr std::size_t max_size		= std::size_t( 1 ) << max_shift;
+	static constexpr std::size_t max_pooled		= 64;	// per size class, a full recvmmsg batch
+
+	static recv_pool&
+	current()
+	{
+		static thread_local holder h;
+
+		return *h.m_pool;
+	}
+
+	/*
+	 * Returns a block of at least size bytes, clamped to [min_size, max_size],
+	 * and sets len to its actual size.
+	 */
+
+	char*
+	allocate( std::size_t size, std::size_t &len )
+	{
+		auto index	= size_class( size );
+		auto &list	= m_free[ index ];
+		header *hdr;
+
+		if ( list.empty() )
+		{
+			hdr = reinterpret_cast< header* >( ::operator new( sizeof( header ) + ( min_size << index ) ) );
+			hdr->m_pool		= this;
+			hdr->m_index	= index;
+		}
+		else
+		{
+			hdr = list.back();
+			list.pop_back();
+		}
+
+		m_refs.fetch_add( 1, std::memory_order_relaxed );
+
+		len = min_size << index;
+
+		return reinterpret_cast< char* >( hdr + 1 );
+	}
+
+	/*
+	 * Both the dealloc functor of the buffers we push and the way to give
+	 * back a block that was never filled.
+	 */
+
+	static void
+	release( void *data )
+	{
+		auto hdr	= reinterpret_cast< header* >( data ) - 1;
+		auto pool	= hdr->m_pool;
+
+		if ( ( pool == t_current ) && ( pool->m_free[ hdr->m_index ].size() < max_pooled ) )
+		{
+			pool->m_free[ hdr->m_index ].push_back( hdr );
+		}
+		else
+		{
+			::operator delete( hdr );
+		}
+
+		pool->unref();
+	}
+
+private:
+
+	struct alignas( std::max_align_t ) header
+	{
+		recv_pool		*m_pool;
+		std::size_t		m_index;
+	};
+
+	struct holder
+	{
+		holder()
+		:
+			m_pool( new recv_pool )
+		{
+			t_current = m_pool;
+		}
+
+		~holder()
+		{
+			t_current = nullptr;
+			m_pool->clear();
+			m_pool->unref();
+		}
+
+		recv_pool *m_pool;
+	};
+
+	static constexpr std::size_t num_classes = max_shift - min_shift + 1;
+
+	recv_pool()
+	:
+		m_refs( 1 )
+	{
+	}
+
+	static std::size_t
+	size_class( std::size_t size )
+	{
+		std::size_t index = 0;
+
+		while ( ( index < num_classes - 1 ) && ( ( min_size << index ) < size ) )
+		{
+			index++;
+		}
+
+		return index;
+	}
+
+	void
+	clear()
+	{
+		for ( auto &list : m_free )
+		{
+			for ( auto hdr : list )
+			{
+				::operator delete( hdr );
+			}
+
+			list.clear();
+		}
+	}
+
+	void
+	unref()
+	{
+		if ( m_refs.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+		{
+			delete this;
+		}
+	}
+
+	static thread_local recv_pool	*t_current;
+
+	std::atomic< std::size_t >		m_refs;
+	std::vector< header* >			m_free[ num_classes ];
+};
+
+thread_local recv_pool *recv_pool::t_current = nullptr;
+
+/*
+ * Chooses the block size for a socket's next read: a running average of
+ * its recent reads, doubled whenever a read fills the block it was given.
+ * Starts at the largest size, which is what libuv asks for.
+ */
+
+class recv_sizer
+{
+public:
+
+	recv_sizer()
+	:
+		m_estimate( recv_pool::max_size )
+	{
+	}
+
+	inline std::size_t
+	next() const
+	{
+		return m_estimate;
+	}
+
+	inline void
+	update( std::size_t nread, std::size_t len )
+	{
+		if ( nread >= len )
+		{
+			m_estimate = std::min( len * 2, recv_pool::max_size );
+		}
+		else
+		{
+			m_estimate = std::max( ( m_estimate * 3 + nread ) / 4, recv_pool::min_size );
+		}
+	}
+
+private:
+
+	std::size_t m_estimate;
+};
+
 #if defined( __APPLE__ )
 #	pragma mark net::tcp::socket implementation
 #endif
@@ -72,7 +286,7 @@ public:
 		m_options( ip::endpoint() ),
 		m_handle( nullptr )
 	{
-		m_recv_buf.make_no_copy_on_write();
+		set_write_window( write_window_size );
 	}
 
 	net_tcp_socket( options options )
@@ -80,18 +294,26 @@ public:
 		m_options( std::move( options ) ),
 		m_handle( nullptr )
 	{
-		m_recv_buf.make_no_copy_on_write();
+		set_write_window( write_window_size );
 	}
 
+	// libuv queues uv_writes on a stream in order, so several can be in flight
+
+	static const std::size_t write_window_size = 4;
+
 	virtual ~net_tcp_socket()
 	{
+		for ( auto req : m_free_writes )
+		{
+			delete req;
+		}
 	}
 
 	std::error_code
 	accept( uv_tcp_t *handle )
 	{
 		m_handle = new uv_tcp_t;
-		uv_tcp_init( uv_default_loop(), m_handle );
+		uv_tcp_init( libuv::current_loop(), m_handle );
 		m_handle->data = this;
 		auto err = std::error_code( uv_accept( reinterpret_cast< uv_stream_t* >( handle ), reinterpret_cast< uv_stream_t* >( m_handle ) ), libuv::error_category() );
 
@@ -106,7 +328,7 @@ public:
 		m_handle		= new uv_tcp_t;
 		m_handle->data	= this;
 
-		auto err = std::error_code( uv_tcp_init( uv_default_loop(), m_handle ), libuv::error_category() );
+		auto err = std::error_code( uv_tcp_init( libuv::current_loop(), m_handle ), libuv::error_category() );
 
 		if ( !err )
 		{
@@ -170,28 +392,114 @@ public:
 		} );
 	}
 
+	/*
+	 * A gathered write: every buffer goes out in one uv_write. Requests are
+	 * recycled per socket, and their vectors keep their capacity.
+	 */
+
+	struct write_t : public uv_write_t
+	{
+		std::vector< buffer >	m_bufs;
+		std::vector< uv_buf_t >	m_uv_bufs;
+		promise< void >			m_ret;
+	};
+
+	static const std::size_t max_free_writes = 4;
+
+	write_t*
+	acquire_write()
+	{
+		write_t *req;
+
+		if ( m_free_writes.empty() )
+		{
+			req = new write_t;
+		}
+		else
+		{
+			req = m_free_writes.back();
+			m_free_writes.pop_back();
+		}
+
+		return req;
+	}
+
+	void
+	release_write( write_t *req )
+	{
+		req->m_bufs.clear();
+
+		if ( m_free_writes.size() < max_free_writes )
+		{
+			m_free_writes.push_back( req );
+		}
+		else
+		{
+			delete req;
+		}
+	}
+
 	virtual promise< void >
 	really_write( buffer buf )
+	{
+		auto req = acquire_write();
+
+		req->m_bufs.emplace_back( std::move( buf ) );
+
+		return send( req );
+	}
+
+	virtual promise< void >
+	really_writev( std::vector< buffer > &bufs )
+	{
+		auto req = acquire_write();
+
+		// swap rather than move, so both vectors keep their capacity
+
+		req->m_bufs.swap( bufs );
+
+		return send( req );
+	}
+
+	promise< void >
+	send( write_t *req )
 	{
 		auto ret = promise< void >();
 
 		assert( m_handle );
 
-		if ( m_handle )
+		// send_done() finds us through the handle, even when uv_write() fails
+		// before libuv has filled it in
+
+		req->handle	= reinterpret_cast< uv_stream_t* >( m_handle );
+		req->m_ret	= ret;
+		req->m_uv_bufs.clear();
+
+		for ( auto &buf : req->m_bufs )
 		{
 			if ( buf.size() > 0 )
 			{
-				auto req	= new write_t( m_handle, std::move( buf ), ret );
-				auto err	= uv_write( req, reinterpret_cast< uv_stream_t* >( m_handle ), &req->m_uv_buf, 1, reinterpret_cast< uv_write_cb >( on_send ) );
-				ncheck_error_action( err == 0, on_send( req, err ), exit );
+				req->m_uv_bufs.emplace_back( uv_buf_init( reinterpret_cast< char* >( buf.mutable_data() ), static_cast< unsigned int >( buf.size() ) ) );
+			}
+		}
+
+		if ( m_handle )
+		{
+			if ( req->m_uv_bufs.size() > 0 )
+			{
+				auto err = uv_write( req, reinterpret_cast< uv_stream_t* >( m_handle ), req->m_uv_bufs.data(), static_cast< unsigned int >( req->m_uv_bufs.size() ), reinterpret_cast< uv_write_cb >( on_send ) );
+				ncheck_error_action( err == 0, send_done( req, err ), exit );
+				m_uv_writes++;
 			}
 			else
 			{
+				release_write( req );
 				ret.resolve();
 			}
 		}
 		else
 		{
+			release_write( req );
 			ret.reject( make_error_code( std::errc::invalid_argument ) );
 		}
 		
@@ -240,27 +548,6 @@ public:
 		return;
 	}
 
-	struct write_t : public uv_write_t
-	{
-		write_t( uv_tcp_t *handle, buffer buf, promise< void > ret )
-		:
-			m_buf( std::move( buf ) ),
-			m_ret( ret )
-		{
-			this->handle	= reinterpret_cast< uv_stream_t* >( handle );
-			m_uv_buf.base	= reinterpret_cast< char* >( m_buf.mutable_data() );
-#if defined( WIN32 )
-			m_uv_buf.len	= static_cast< ULONG >( m_buf.size() );
-#else
-			m_uv_buf.len	= m_buf.size();
-#endif
-		}
-	
-		uv_buf_t		m_uv_buf;
-		buffer			m_buf;
-		promise< void >	m_ret;
-	};
-
 	inline void
 	set_keep_alive( bool val )
 	{
@@ -275,14 +562,15 @@ public:
 		auto self = reinterpret_cast< net_tcp_socket* >( handle->data );
 		ncheck_error( self, exit );
 		ncheck_error( buf, exit );
-		
-		self->m_recv_buf.capacity( size_hint );
-		
-		buf->base	= reinterpret_cast< char* >( self->m_recv_buf.mutable_data() );
+		nunused( size_hint );
+
+		std::size_t len;
+
+		buf->base	= recv_pool::current().allocate( self->m_recv_sizer.next(), len );
 	#if defined( WIN32 )
-		buf->len	= static_cast< ULONG >( size_hint );
+		buf->len	= static_cast< ULONG >( len );
 	#else
-		buf->len	= size_hint;
+		buf->len	= len;
 	#endif
 		
 	exit:
@@ -322,10 +610,22 @@ public:
 
 			delete req;
 		}
+
+		runloop::current().drain_microtasks();
 	}
 
 	inline static void
 	on_send( write_t *req, int libuv_err )
+	{
+		send_done( req, libuv_err );
+		runloop::current().drain_microtasks();
+	}
+
+	// also called directly when the send fails synchronously, where
+	// draining would run microtasks inside the caller's write
+
+	inline static void
+	send_done( write_t *req, int libuv_err )
 	{
 		auto err = std::error_code( libuv_err, libuv::error_category() );
 
@@ -342,13 +642,20 @@ public:
 
 				if ( self )
 				{
+					// recycle first, so the next write can reuse this request
+
+					auto ret = std::move( req->m_ret );
+
+					self->release_write( req );
+					req = nullptr;
+
 					if ( !err )
 					{
-						req->m_ret.resolve();
+						ret.resolve();
 					}
 					else
 					{
-						req->m_ret.reject( err );
+						ret.reject( err );
 						self->emit( "error", err );
 					}
 				}
@@ -362,33 +669,39 @@ public:
 	on_recv( uv_tcp_t *handle, std::int32_t nread, const uv_buf_t *buf )
 	{
 		assert( handle );
-		nunused( buf );
+		assert( buf );
 
-		if ( handle )
+		// the block is ours again unless it is handed off below
+
+		auto self = handle ? reinterpret_cast< net_tcp_socket* >( handle->data ) : nullptr;
+
+		if ( self && ( nread > 0 ) )
 		{
-			auto self = reinterpret_cast< net_tcp_socket* >( handle->data );
-			assert( self );
+			self->m_recv_sizer.update( nread, buf->len );
+			self->push( buffer( buf->base, nread, buffer::policy::copy_on_write, recv_pool::release, nullptr ) );
+		}
+		else
+		{
+			if ( buf->base )
+			{
+				recv_pool::release( buf->base );
+			}
 
-			if ( self )
+			if ( self && ( nread < 0 ) )
 			{
-				if ( nread > 0 )
-				{
-					self->m_recv_buf.size( nread );
-					self->push( self->m_recv_buf );
-				}
-				else if ( nread < 0 )
-				{
-					auto err = std::error_code( nread, libuv::error_category() );
-					self->emit( "error", err );
-					self->m_recv_buf.size( 0 );
-				}
+				auto err = std::error_code( nread, libuv::error_category() );
+				self->emit( "error", err );
 			}
 		}
+
+		runloop::current().drain_microtasks();
 	}
 
 	net::tcp::socket::options	m_options;
-	buffer						m_recv_buf;
+	recv_sizer					m_recv_sizer;
 	uv_tcp_t					*m_handle;
+	std::vector< write_t* >		m_free_writes;
+	std::size_t					m_uv_writes = 0;	// issued, for the tests
 };
 
 net::tcp::socket::~socket()
@@ -440,12 +753,19 @@ public:
 		m_handle = new uv_tcp_t;
 		sockaddr_storage	addr;
 		int					len;
-		auto err = std::error_code( uv_tcp_init( uv_default_loop(), m_handle ), libuv::error_category() );
+		
+		ip::endpoint_to_sockaddr( m_options.endpoint(), addr );
+
+		auto err = std::error_code( uv_tcp_init_ex( libuv::current_loop(), m_handle, addr.ss_family ), libuv::error_category() );
 		ncheck_error( !err, exit );
 		assert( m_handle->type == UV_TCP );
 		m_handle->data = this;
-		
-		ip::endpoint_to_sockaddr( m_options.endpoint(), addr );
+
+		if ( m_options.reuse_port() )
+		{
+			err = set_reuse_port();
+			ncheck_error( !err, exit );
+		}
 		
 		err = std::error_code( uv_tcp_bind( m_handle, reinterpret_cast< sockaddr* >( &addr ), 0 ), libuv::error_category() );
 		ncheck_error( !err, exit );
@@ -459,7 +779,7 @@ public:
 		err = std::error_code( uv_listen( reinterpret_cast< uv_stream_t* >( m_handle ), static_cast< int >( m_options.qsize() ), reinterpret_cast< uv_connection_cb >( on_accept ) ), libuv::error_category() );
 		ncheck_error_action( !err, emit( "error", err ), exit );
 
-		runloop::shared().dispatch( [=]() mutable
+		runloop::current().next_tick( [=]() mutable
 		{
 			emit( "listening" );
 		} );
@@ -488,6 +808,28 @@ public:
 
 private:
 
+	std::error_code
+	set_reuse_port()
+	{
+#if defined( SO_REUSEPORT )
+		uv_os_fd_t	fd;
+		int			on = 1;
+		auto err = std::error_code( uv_fileno( reinterpret_cast< uv_handle_t* >( m_handle ), &fd ), libuv::error_category() );
+		ncheck_error( !err, exit );
+
+		if ( ::setsockopt( fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof( on ) ) != 0 )
+		{
+			err = std::error_code( errno, std::generic_category() );
+		}
+
+	exit:
+
+		return err;
+#else
+		return make_error_code( std::errc::operation_not_supported );
+#endif
+	}
+
 	inline static void
 	on_accept( uv_tcp_t *handle, int libuv_err )
 	{
@@ -523,6 +865,8 @@ private:
 				}
 			}
 		}
+
+		runloop::current().drain_microtasks();
 	}
 
 	options			m_options;
@@ -566,10 +910,21 @@ class net_udp_socket : public net::udp::socket
 {
 public:
 
+	// the most datagrams moved by one recvmmsg or sendmmsg
+
+	static constexpr std::size_t max_batch_size = 64;
+
 	net_udp_socket( options options )
 	:
 		m_options( std::move( options ) ),
 		m_handle( nullptr )
+#if defined( __linux__ )
+		,
+		m_poll( nullptr ),
+		m_recv_blocks( initial_recv_blocks ),
+		m_flushing( false ),
+		m_waiting( false )
+#endif
 	{
 	}
 
@@ -583,45 +938,55 @@ public:
 		struct sockaddr_storage addr;
 
 		m_handle = new uv_udp_t;
-		auto err = std::error_code( uv_udp_init( uv_default_loop(), m_handle ), libuv::error_category() );
+		auto err = std::error_code( uv_udp_init( libuv::current_loop(), m_handle ), libuv::error_category() );
 		ncheck_error( !err, exit );
-	
+
 		m_handle->data = this;
-	
+
 		ip::endpoint_to_sockaddr( m_options.endpoint(), addr );
-		
+
 		err = std::error_code( uv_udp_bind( m_handle, reinterpret_cast< sockaddr* >( &addr ), UV_UDP_REUSEADDR ), libuv::error_category() );
 		ncheck_error( !err, exit );
-		
-		err = std::error_code( uv_udp_recv_start( m_handle, reinterpret_cast< uv_alloc_cb >( on_alloc ), reinterpret_cast< uv_udp_recv_cb >( on_recv ) ), libuv::error_category() );
+
+#if defined( __linux__ )
+		if ( batched() )
+		{
+			err = start_polling();
+		}
+		else
+#endif
+		{
+			err = std::error_code( uv_udp_recv_start( m_handle, reinterpret_cast< uv_alloc_cb >( on_alloc ), reinterpret_cast< uv_udp_recv_cb >( on_recv ) ), libuv::error_category() );
+		}
+
 		ncheck_error( !err, exit );
-		
+
 	exit:
-	
+
 		return err;
 	}
 
-	inline ip::endpoint
+	virtual ip::endpoint
 	name() const
 	{
 		sockaddr_storage	addr;
 		int					len;
 		ip::endpoint		ret;
-		
+
 		memset( &addr, 0, sizeof( addr ) );
 		len = sizeof( sockaddr_storage );
 		uv_udp_getsockname( m_handle, reinterpret_cast< sockaddr* >( &addr ), &len );
-		
+
 		ip::sockaddr_to_endpoint( addr, ret );
-		
+
 		return ret;
 	}
-	
-	inline std::error_code
+
+	virtual std::error_code
 	set_membership( const ip::endpoint &endpoint, const ip::address iface, multicast_membership_type membership )
 	{
 		auto err = std::error_code();
-		
+
 		err = std::error_code( uv_udp_set_membership( m_handle, endpoint.addr().to_string().c_str(), iface.to_string().c_str(), membership == multicast_membership_type::join ? UV_JOIN_GROUP : UV_LEAVE_GROUP ), libuv::error_category() );
 		ncheck_error( !err, exit );
 		if ( membership == multicast_membership_type::join )
@@ -634,8 +999,8 @@ public:
 
 		return err;
 	}
-	
-	inline std::error_code
+
+	virtual std::error_code
 	set_broadcast( bool val )
 	{
 		auto err = std::error_code( uv_udp_set_broadcast( m_handle, val ), libuv::error_category() );
@@ -646,35 +1011,112 @@ public:
 		return err;
 	}
 
-	inline void
-	send( buffer buf, const ip::endpoint &to, promise< void > ret )
+	virtual promise< void >
+	send( buffer buf, const ip::endpoint &to )
 	{
-		sockaddr_storage addr;
-		
-		memset( &addr, 0, sizeof( addr ) );
-		
-		ip::endpoint_to_sockaddr( to, addr );
-		
-		auto request	= new write_s( m_handle, buf, ret );
-		auto err		= uv_udp_send( request, m_handle, &request->m_uv_buf, 1, reinterpret_cast< sockaddr* >( &addr ), reinterpret_cast< uv_udp_send_cb >( on_send ) );
-		ncheck_error_action( err == 0, on_send( request, err ), exit );
-		
+		auto ret = promise< void >();
+
+#if defined( __linux__ )
+		if ( m_poll )
+		{
+			enqueue( to, std::move( buf ), ret, true );
+			flush();
+		}
+		else
+#endif
+		{
+			sockaddr_storage addr;
+
+			memset( &addr, 0, sizeof( addr ) );
+
+			ip::endpoint_to_sockaddr( to, addr );
+
+			auto request	= new write_s( m_handle, std::move( buf ), ret );
+			auto err		= uv_udp_send( request, m_handle, &request->m_uv_buf, 1, reinterpret_cast< sockaddr* >( &addr ), reinterpret_cast< uv_udp_send_cb >( on_send ) );
+			ncheck_error_action( err == 0, send_done( request, err ), exit );
+		}
+
 	exit:
 
-		return;
+		return ret;
 	}
 
-	inline void
+	virtual promise< void >
+	send( std::vector< net::udp::datagram > batch )
+	{
+		auto ret = promise< void >();
+
+		if ( batch.empty() )
+		{
+			ret.resolve();
+		}
+#if defined( __linux__ )
+		else if ( m_poll )
+		{
+			for ( auto i = 0u; i < batch.size(); i++ )
+			{
+				enqueue( batch[ i ].peer, std::move( batch[ i ].data ), ret, i == batch.size() - 1 );
+			}
+
+			flush();
+		}
+#endif
+		else
+		{
+			auto sends = promise< void >::promises_type();
+
+			for ( auto &dgram : batch )
+			{
+				sends.emplace_back( send( std::move( dgram.data ), dgram.peer ) );
+			}
+
+			ret = promise< void >::all( std::move( sends ) );
+		}
+
+		return ret;
+	}
+
+	virtual void
 	close()
 	{
+#if defined( __linux__ )
+		if ( m_poll )
+		{
+			uv_close( reinterpret_cast< uv_handle_t* >( m_poll ), []( uv_handle_t *handle )
+			{
+				delete reinterpret_cast< uv_poll_t* >( handle );
+			} );
+
+			m_poll = nullptr;
+
+			while ( !m_outbox.empty() )
+			{
+				auto pending = std::move( m_outbox.front() );
+
+				m_outbox.pop_front();
+
+				if ( pending.m_last )
+				{
+					pending.m_ret.reject( make_error_code( std::errc::operation_canceled ) );
+				}
+			}
+		}
+#endif
+
 		uv_close( reinterpret_cast< uv_handle_t* >( m_handle ), []( uv_handle_t *handle )
 		{
-			delete handle;
+			delete reinterpret_cast< uv_udp_t* >( handle );
 		} );
 	}
 
 protected:
 
+	inline bool
+	batched() const
+	{
+		return m_options.batch_size() > 1;
+	}
+
 	struct write_s : public uv_udp_send_s
 	{
 		write_s( uv_udp_t *handle, buffer buf, promise< void > ret )
@@ -691,7 +1133,7 @@ protected:
 			m_uv_buf.len	= m_buf.size();
 #endif
 		}
-	
+
 		uv_buf_t				m_uv_buf;
 		buffer					m_buf;
 		promise< void >			m_ret;
@@ -699,6 +1141,13 @@ protected:
 
 	inline static void
 	on_send( write_s *req, int libuv_err )
+	{
+		send_done( req, libuv_err );
+		runloop::current().drain_microtasks();
+	}
+
+	inline static void
+	send_done( write_s *req, int libuv_err )
 	{
 		auto err = std::error_code( libuv_err, libuv::error_category() );
 
@@ -706,20 +1155,16 @@ protected:
 
 		if ( req )
 		{
-			auto handle = reinterpret_cast< uv_udp_t* >( req->handle );
-			assert( handle );
-
-			if ( handle )
+			if ( !err )
 			{
-				auto self = reinterpret_cast< net_udp_socket* >( handle->data );
-
-				//self->on_send( error, request->m_ret );
+				req->m_ret.resolve();
 			}
-		
-			if ( req )
+			else
 			{
-				delete req;
+				req->m_ret.reject( err );
 			}
+
+			delete req;
 		}
 	}
 
@@ -730,48 +1175,409 @@ protected:
 		assert( buf );
 
 		auto self = reinterpret_cast< net_udp_socket* >( handle->data );
-		
-		self->m_recv_buf.capacity( size_hint );
-		
-		buf->base	= reinterpret_cast< char* >( self->m_recv_buf.mutable_data() );
+		nunused( size_hint );
+
+		std::size_t len;
+
+		buf->base	= recv_pool::current().allocate( self->m_recv_sizer.next(), len );
 #if defined( WIN32 )
-		buf->len	= static_cast< ULONG >( size_hint );
+		buf->len	= static_cast< ULONG >( len );
 #else
-		buf->len	= size_hint;
+		buf->len	= len;
 #endif
 	}
 
+	// a buffer won't take ownership of an empty block, so an empty datagram
+	// gets an empty buffer and its block goes straight back to the pool
+
+	inline static buffer
+	adopt( void *block, std::size_t len )
+	{
+		if ( len == 0 )
+		{
+			recv_pool::release( block );
+			return buffer();
+		}
+
+		return buffer( block, len, buffer::policy::copy_on_write, recv_pool::release, nullptr );
+	}
+
 	inline static void
 	on_recv( uv_udp_t *handle, std::int32_t nread, const uv_buf_t *buf, const struct sockaddr *addr, unsigned flags )
 	{
 		assert( handle );
 		assert( buf );
 
-		nunused( flags );
-		
+		auto self = reinterpret_cast< net_udp_socket* >( handle->data );
+
 		ip::endpoint from;
-		
+
 		if ( addr )
 		{
 			ip::sockaddr_to_endpoint( *reinterpret_cast< const sockaddr_storage* >( addr ), from );
 		}
-		
-		if ( nread > 0 )
+
+		// a truncated datagram is lost, but the next read gets the largest block
+
+		if ( flags & UV_UDP_PARTIAL )
 		{
-//			self->owner()->on_recv( std::error_code(), from, buffer( buf->base, nread, nread, buffer::do_not_delete_data ) );
-			// self->on_recv( std::error_code(), from, buffer( buf->base, nread, buffer::policy::exclusive, nullptr, nullptr ) );
+			nread = UV_EMSGSIZE;
+			self->m_recv_sizer.update( buf->len, buf->len );
 		}
-		else if ( nread < 0 )
+
+		// nread is 0 both for an empty datagram and for "nothing more to
+		// read"; only the former comes with an address
+
+		if ( ( nread > 0 ) || ( ( nread == 0 ) && addr ) )
 		{
-			// self->on_recv( std::error_code( nread, libuv::error_category() ), from, buffer() );
+			auto data = adopt( buf->base, nread );
+
+			self->m_recv_sizer.update( nread, buf->len );
+
+			if ( self->batched() )
+			{
+				self->emit( "messages", std::vector< net::udp::datagram >{ net::udp::datagram{ std::move( from ), std::move( data ) } } );
+			}
+			else
+			{
+				self->emit( "message", std::move( data ), from );
+			}
 		}
+		else
+		{
+			if ( buf->base )
+			{
+				recv_pool::release( buf->base );
+			}
+
+			if ( nread < 0 )
+			{
+				self->emit( "error", std::error_code( nread, libuv::error_category() ) );
+			}
+		}
+
+		runloop::current().drain_microtasks();
 	}
 
-	options		m_options;
-	buffer		m_recv_buf;
-	uv_udp_t	*m_handle;
+#if defined( __linux__ )
+
+	/*
+	 * Batched sockets bypass libuv's per datagram reads and writes. The
+	 * uv_udp_t still owns the socket, but it never starts watching it, so a
+	 * uv_poll_t on the same descriptor can drive recvmmsg and sendmmsg.
+	 */
+
+	static constexpr std::size_t initial_recv_blocks = 4;
+
+	struct pending
+	{
+		sockaddr_storage	m_addr;
+		buffer				m_buf;
+		promise< void >		m_ret;
+		bool				m_last;		// settles m_ret
+	};
+
+	std::error_code
+	start_polling()
+	{
+		uv_os_fd_t fd;
+
+		auto err = std::error_code( uv_fileno( reinterpret_cast< uv_handle_t* >( m_handle ), &fd ), libuv::error_category() );
+		ncheck_error( !err, exit );
+
+		m_poll = new uv_poll_t;
+
+		err = std::error_code( uv_poll_init_socket( libuv::current_loop(), m_poll, fd ), libuv::error_category() );
+		ncheck_error_action( !err, delete m_poll; m_poll = nullptr, exit );
+
+		m_poll->data = this;
+
+		err = std::error_code( uv_poll_start( m_poll, UV_READABLE, reinterpret_cast< uv_poll_cb >( on_poll ) ), libuv::error_category() );
+		ncheck_error( !err, exit );
+
+	exit:
+
+		return err;
+	}
+
+	inline int
+	fd() const
+	{
+		uv_os_fd_t fd = -1;
+
+		uv_fileno( reinterpret_cast< const uv_handle_t* >( m_handle ), &fd );
+
+		return fd;
+	}
+
+	inline static socklen_t
+	sockaddr_len( const sockaddr_storage &addr )
+	{
+		return ( addr.ss_family == AF_INET6 ) ? sizeof( sockaddr_in6 ) : sizeof( sockaddr_in );
+	}
+
+	inline static void
+	on_poll( uv_poll_t *handle, int status, int events )
+	{
+		auto self = reinterpret_cast< net_udp_socket* >( handle->data );
+
+		if ( status < 0 )
+		{
+			self->emit( "error", std::error_code( status, libuv::error_category() ) );
+		}
+		else
+		{
+			if ( events & UV_WRITABLE )
+			{
+				self->m_waiting = false;
+				uv_poll_start( handle, UV_READABLE, reinterpret_cast< uv_poll_cb >( on_poll ) );
+				self->flush();
+			}
+
+			// the flush may have closed us
+
+			if ( ( events & UV_READABLE ) && self->m_poll )
+			{
+				self->recv_batch();
+			}
+		}
+
+		runloop::current().drain_microtasks();
+	}
+
+	void
+	recv_batch()
+	{
+		mmsghdr				msgs[ max_batch_size ];
+		iovec				iovs[ max_batch_size ];
+		sockaddr_storage	addrs[ max_batch_size ];
+		auto				count = std::min( { m_recv_blocks, m_options.batch_size(), max_batch_size } );
+		auto				batch = std::vector< net::udp::datagram >();
+		auto				truncated = false;
+		int					n;
+		int					sys_err;
+
+		for ( auto i = 0u; i < count; i++ )
+		{
+			std::size_t len;
+
+			iovs[ i ].iov_base				= recv_pool::current().allocate( m_recv_sizer.next(), len );
+			iovs[ i ].iov_len				= len;
+
+			memset( &msgs[ i ].msg_hdr, 0, sizeof( msgs[ i ].msg_hdr ) );
+			msgs[ i ].msg_hdr.msg_name		= &addrs[ i ];
+			msgs[ i ].msg_hdr.msg_namelen	= sizeof( addrs[ i ] );
+			msgs[ i ].msg_hdr.msg_iov		= &iovs[ i ];
+			msgs[ i ].msg_hdr.msg_iovlen	= 1;
+			msgs[ i ].msg_len				= 0;
+		}
+
+		do
+		{
+			n = ::recvmmsg( fd(), msgs, static_cast< unsigned int >( count ), MSG_DONTWAIT, nullptr );
+		}
+		while ( ( n < 0 ) && ( errno == EINTR ) );
+
+		sys_err = ( n < 0 ) ? errno : 0;
+
+		// offer as many blocks as recent reads have needed: twice as many
+		// after a read that took them all, and half after one that used few
+
+		if ( n == static_cast< int >( count ) )
+		{
+			m_recv_blocks = std::min( count * 2, max_batch_size );
+		}
+		else if ( ( n > 0 ) && ( static_cast< std::size_t >( n ) * 4 <= count ) )
+		{
+			m_recv_blocks = std::max( count / 2, initial_recv_blocks );
+		}
+
+		for ( auto i = 0; i < n; i++ )
+		{
+			if ( msgs[ i ].msg_hdr.msg_flags & MSG_TRUNC )
+			{
+				m_recv_sizer.update( iovs[ i ].iov_len, iovs[ i ].iov_len );
+				truncated = true;
+			}
+			else
+			{
+				ip::endpoint from;
+
+				ip::sockaddr_to_endpoint( addrs[ i ], from );
+
+				m_recv_sizer.update( msgs[ i ].msg_len, iovs[ i ].iov_len );
+				batch.emplace_back( net::udp::datagram{ std::move( from ), adopt( iovs[ i ].iov_base, msgs[ i ].msg_len ) } );
+				iovs[ i ].iov_base = nullptr;
+			}
+		}
+
+		for ( auto i = 0u; i < count; i++ )
+		{
+			if ( iovs[ i ].iov_base )
+			{
+				recv_pool::release( iovs[ i ].iov_base );
+			}
+		}
+
+		if ( !batch.empty() )
+		{
+			emit( "messages", std::move( batch ) );
+		}
+
+		if ( truncated )
+		{
+			emit( "error", std::error_code( UV_EMSGSIZE, libuv::error_category() ) );
+		}
+		else if ( sys_err && ( sys_err != EAGAIN ) && ( sys_err != EWOULDBLOCK ) )
+		{
+			emit( "error", std::error_code( sys_err, std::system_category() ) );
+		}
+	}
+
+	void
+	enqueue( const ip::endpoint &to, buffer buf, promise< void > ret, bool last )
+	{
+		m_outbox.emplace_back();
+
+		auto &pending = m_outbox.back();
+
+		memset( &pending.m_addr, 0, sizeof( pending.m_addr ) );
+		ip::endpoint_to_sockaddr( to, pending.m_addr );
+
+		pending.m_buf	= std::move( buf );
+		pending.m_ret	= std::move( ret );
+		pending.m_last	= last;
+	}
+
+	/*
+	 * Sends as much of the outbox as the socket will take. A batch whose
+	 * datagram is refused is rejected, and the rest of it is dropped.
+	 * Settling a promise may queue more, which this same loop picks up.
+	 */
+
+	void
+	flush()
+	{
+		mmsghdr	msgs[ max_batch_size ];
+		iovec	iovs[ max_batch_size ];
+
+		if ( m_flushing || m_waiting )
+		{
+			return;
+		}
+
+		m_flushing = true;
+
+		while ( m_poll && !m_outbox.empty() )
+		{
+			auto count = std::min( m_outbox.size(), max_batch_size );
+			int n;
+
+			for ( auto i = 0u; i < count; i++ )
+			{
+				auto &pending = m_outbox[ i ];
+
+				iovs[ i ].iov_base				= pending.m_buf.mutable_data();
+				iovs[ i ].iov_len				= pending.m_buf.size();
+
+				memset( &msgs[ i ].msg_hdr, 0, sizeof( msgs[ i ].msg_hdr ) );
+				msgs[ i ].msg_hdr.msg_name		= &pending.m_addr;
+				msgs[ i ].msg_hdr.msg_namelen	= sockaddr_len( pending.m_addr );
+				msgs[ i ].msg_hdr.msg_iov		= &iovs[ i ];
+				msgs[ i ].msg_hdr.msg_iovlen	= 1;
+				msgs[ i ].msg_len				= 0;
+			}
+
+			n = ::sendmmsg( fd(), msgs, static_cast< unsigned int >( count ), MSG_DONTWAIT );
+
+			if ( n >= 0 )
+			{
+				// a promise settled here may close us, which empties the outbox
+
+				for ( auto i = 0; ( i < n ) && !m_outbox.empty(); i++ )
+				{
+					auto pending = std::move( m_outbox.front() );
+
+					m_outbox.pop_front();
+
+					if ( pending.m_last )
+					{
+						pending.m_ret.resolve();
+					}
+				}
+			}
+			else if ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) || ( errno == ENOBUFS ) )
+			{
+				m_waiting = true;
+				uv_poll_start( m_poll, UV_READABLE | UV_WRITABLE, reinterpret_cast< uv_poll_cb >( on_poll ) );
+				break;
+			}
+			else if ( errno != EINTR )
+			{
+				auto err = std::error_code( errno, std::system_category() );
+				auto done = false;
+
+				while ( !done && !m_outbox.empty() )
+				{
+					auto pending = std::move( m_outbox.front() );
+
+					m_outbox.pop_front();
+
+					if ( pending.m_last )
+					{
+						pending.m_ret.reject( err );
+						done = true;
+					}
+				}
+
+				emit( "error", err );
+			}
+		}
+
+		m_flushing = false;
+	}
+
+#endif
+
+	options					m_options;
+	recv_sizer				m_recv_sizer;
+	uv_udp_t				*m_handle;
+#if defined( __linux__ )
+	uv_poll_t				*m_poll;
+	std::size_t				m_recv_blocks;
+	std::deque< pending >	m_outbox;
+	bool					m_flushing;
+	bool					m_waiting;
+#endif
 };
 
+net::udp::socket::~socket()
+{
+}
+
+net::udp::socket::ptr
+net::udp::socket::create( net::udp::socket::options options )
+{
+	auto err = std::error_code();
+	auto ret = create( std::move( options ), err );
+
+	if ( err )
+	{
+	}
+
+	return ret;
+}
+
+net::udp::socket::ptr
+net::udp::socket::create( net::udp::socket::options options, std::error_code &err )
+{
+	auto ret = std::make_shared< net_udp_socket >( std::move( options ) );
+
+	err = ret->init();
+
+	return ret;
+}
+
 TEST_CASE( "nodeoze/smoke/net/tcp")
 {
 	auto message									= std::string( "this is one small step for man" );
@@ -853,4 +1659,184 @@ TEST_CASE( "nodeoze/smoke/net/tcp")
 	REQUIRE( client_events[ 0 ] == "connect" );
 	REQUIRE( client_events[ 1 ] == "drain" );
 	REQUIRE( client_events[ 2 ] == "data" );
-}
\ No newline at end of file
+}
+TEST_CASE( "nodeoze/smoke/net/tcp/coalesce")
+{
+	auto name										= ip::endpoint( "127.0.0.1", 5556 );
+	auto server										= net::tcp::server::create( name );
+	deque< std::shared_ptr< net::tcp::socket > >	connections;
+	auto client										= net::tcp::socket::create( name );
+	auto expected									= std::string();
+	auto received									= std::string();
+	auto held										= std::vector< buffer >();
+	auto drains										= 0;
+	bool											done = false;
+
+	for ( auto i = 0; i < 200; i++ )
+	{
+		expected += "message " + std::to_string( i ) + ";";
+	}
+
+	server->on( "connection", [&]( net::tcp::socket::ptr sock ) mutable
+	{
+		connections.emplace_back( std::move( sock ) );
+
+		connections.back()->on( "data", [&]( buffer buf ) mutable
+		{
+			// hold on to every read; the socket must not reuse their memory
+
+			received += buf.to_string();
+			held.emplace_back( std::move( buf ) );
+
+			if ( received.size() >= expected.size() )
+			{
+				done = true;
+			}
+		} );
+	} );
+
+	server->on( "error", [&]( std::error_code err ) mutable
+	{
+		CHECK( !err );
+		done = true;
+	} );
+
+	client->on( "connect", [&]() mutable
+	{
+		// the first write goes out on its own, the rest are gathered
+
+		for ( auto i = 0; i < 200; i++ )
+		{
+			client->write( "message " + std::to_string( i ) + ";" );
+		}
+	} );
+
+	client->on( "drain", [&]() mutable
+	{
+		drains++;
+	} );
+
+	client->on( "error", [&]( std::error_code err ) mutable
+	{
+		CHECK( !err );
+		done = true;
+	} );
+
+	while ( !done )
+	{
+		runloop::shared().run( runloop::mode_t::once );
+	}
+
+	auto reassembled = std::string();
+
+	for ( auto &buf : held )
+	{
+		reassembled += buf.to_string();
+	}
+
+	REQUIRE( received == expected );
+	REQUIRE( reassembled == expected );
+	REQUIRE( drains == 1 );
+
+	// the first write goes out alone, the other 199 in gathered batches
+
+	auto writes = std::dynamic_pointer_cast< net_tcp_socket >( client )->m_uv_writes;
+
+	CHECK( writes > 1 );
+	CHECK( writes < 20 );
+}
+
+TEST_CASE( "nodeoze/smoke/net/udp" )
+{
+	auto to			= ip::endpoint( "127.0.0.1", 5557 );
+	auto from		= ip::endpoint( "127.0.0.1", 5558 );
+	auto expected	= std::vector< std::string >();
+	auto received	= std::vector< std::string >();
+	auto sent		= false;
+	auto deadline	= std::chrono::steady_clock::now() + std::chrono::seconds( 10 );
+
+	// an empty datagram is still a datagram
+
+	expected.emplace_back();
+
+	for ( auto i = 0; i < 50; i++ )
+	{
+		expected.emplace_back( "datagram " + std::to_string( i ) );
+	}
+
+	SUBCASE( "single" )
+	{
+		auto receiver	= net::udp::socket::create( to );
+		auto sender		= net::udp::socket::create( from );
+
+		receiver->on( "message", [&]( buffer buf, ip::endpoint peer ) mutable
+		{
+			CHECK( peer.port() == from.port() );
+			received.emplace_back( buf.to_string() );
+		} );
+
+		for ( auto &message : expected )
+		{
+			sender->send( buffer( message ), to ).then( [&]() mutable
+			{
+				sent = true;
+			} );
+		}
+
+		while ( ( received.size() < expected.size() ) && ( std::chrono::steady_clock::now() < deadline ) )
+		{
+			runloop::shared().run( runloop::mode_t::once );
+		}
+
+		receiver->close();
+		sender->close();
+
+		REQUIRE( sent );
+		REQUIRE( received == expected );
+	}
+
+	SUBCASE( "batched" )
+	{
+		auto receiver	= net::udp::socket::create( net::udp::socket::options( to ).batch_size( 16 ) );
+		auto sender		= net::udp::socket::create( net::udp::socket::options( from ).batch_size( 16 ) );
+		auto batch		= std::vector< net::udp::datagram >();
+		auto callbacks	= 0u;
+
+		receiver->on( "messages", [&]( std::vector< net::udp::datagram > datagrams ) mutable
+		{
+			callbacks++;
+
+			for ( auto &dgram : datagrams )
+			{
+				CHECK( dgram.peer.port() == from.port() );
+				received.emplace_back( dgram.data.to_string() );
+			}
+		} );
+
+		for ( auto &message : expected )
+		{
+			batch.emplace_back( net::udp::datagram{ to, buffer( message ) } );
+		}
+
+		sender->send( std::move( batch ) ).then( [&]() mutable
+		{
+			sent = true;
+		} );
+
+		while ( ( received.size() < expected.size() ) && ( std::chrono::steady_clock::now() < deadline ) )
+		{
+			runloop::shared().run( runloop::mode_t::once );
+		}
+
+		receiver->close();
+		sender->close();
+
+		REQUIRE( sent );
+		REQUIRE( received == expected );
+#if defined( __linux__ )
+		REQUIRE( callbacks < expected.size() );
+#endif
+	}
+
+	runloop::shared().run( runloop::mode_t::nowait );
+}
@@ -5,6 +5,7 @@
 #include <nodeoze/thread.h>
 #include <nodeoze/test.h>
 #include "error_libuv.h"
+#include "runloop_libuv.h"
 #include <uv.h>
 #include <fstream>
 #include <cassert>
@@ -41,15 +42,15 @@ struct process_s : public uv_process_s
 		memset( &stdio, 0, sizeof( stdio ) );
 		
 		in	= new pipe_t;
-		uv_pipe_init( uv_default_loop(), in, 0 );
+		uv_pipe_init( libuv::current_loop(), in, 0 );
 		in->data = this;
 		
 		out = new pipe_t;
-		uv_pipe_init( uv_default_loop(), out, 0 );
+		uv_pipe_init( libuv::current_loop(), out, 0 );
 		out->data = this;
 
 		err = new pipe_t;
-		uv_pipe_init( uv_default_loop(), err, 0 );
+		uv_pipe_init( libuv::current_loop(), err, 0 );
 		err->data = this;
 		
 		options.stdio					= stdio;
@@ -274,7 +275,7 @@ process::create( const filesystem::path &exe, const std::vector< std::string > &
 	
 	context->options.exit_cb	= exit_cb;
 
-	auto err = uv_spawn( uv_default_loop(), context.get(), &context->options );
+	auto err = uv_spawn( libuv::current_loop(), context.get(), &context->options );
 	ncheck_error_action( err == 0, ret.reject( std::error_code( err, libuv::error_category() ) ), exit );
 	
 	if ( stdin_handler )
@@ -329,7 +330,7 @@ always_running_process::create( const filesystem::path &exe, const std::vector<
 	{
 		*pid = 0;
 
-		runloop::shared().schedule_oneshot_timer( std::chrono::seconds( 2 ), [=]( auto event ) mutable
+		runloop::current().schedule_oneshot_timer( std::chrono::seconds( 2 ), [=]( auto event ) mutable
 		{
 			nunused( event );
 
@@ -25,10 +25,15 @@
  */
 
 #include <nodeoze/runloop.h>
+#include <nodeoze/timer_wheel.h>
 #include <nodeoze/macros.h>
+#include "runloop_libuv.h"
+#include "error_libuv.h"
 #include <uv.h>
 #include <assert.h>
+#include <system_error>
 #include <thread>
+#include <algorithm>
 
 using namespace nodeoze;
 
@@ -44,8 +49,9 @@ struct uv_event
 #endif
 	};
 	
-	uv_event( type_t t )
+	uv_event( type_t t, runloop *owner )
 	:
+		m_owner( owner ),
 		m_active( false ),
 		m_type( t )
 	{
@@ -139,10 +145,125 @@ struct uv_event
 	};
 	
 	data				m_data;
+	runloop				*m_owner;
 	bool				m_active;
 	type_t				m_type;
 };
 
+// closed events are recycled per loop, up to this many
+
+static const std::size_t max_pooled_events = 1024;
+
+static thread_local runloop *t_current = nullptr;
+
+static inline std::uint64_t
+usec_since( std::chrono::steady_clock::time_point then, std::chrono::steady_clock::time_point now )
+{
+	return ( now > then ) ? static_cast< std::uint64_t >( std::chrono::duration_cast< std::chrono::microseconds >( now - then ).count() ) : 0;
+}
+
+class runloop::instrumentation
+{
+public:
+
+	class recorder
+	{
+	public:
+
+		recorder()
+		{
+			for ( auto &bucket : m_buckets )
+			{
+				bucket = 0;
+			}
+		}
+
+		void
+		record( std::uint64_t val )
+		{
+			std::size_t index = 0;
+
+			for ( auto v = val; v && ( index < histogram::buckets - 1 ); v >>= 1 )
+			{
+				index++;
+			}
+
+			// only the loop thread writes, so plain load/store suffices and
+			// snapshot() readers at worst see a sample half recorded
+
+			m_buckets[ index ].store( m_buckets[ index ].load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+			m_count.store( m_count.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+			m_sum.store( m_sum.load( std::memory_order_relaxed ) + val, std::memory_order_relaxed );
+
+			if ( val > m_max.load( std::memory_order_relaxed ) )
+			{
+				m_max.store( val, std::memory_order_relaxed );
+			}
+		}
+
+		histogram
+		snapshot() const
+		{
+			histogram ret;
+
+			ret.count	= m_count.load( std::memory_order_relaxed );
+			ret.sum		= m_sum.load( std::memory_order_relaxed );
+			ret.max		= m_max.load( std::memory_order_relaxed );
+
+			for ( auto i = 0u; i < histogram::buckets; ++i )
+			{
+				ret.bucket[ i ] = m_buckets[ i ].load( std::memory_order_relaxed );
+			}
+
+			return ret;
+		}
+
+	private:
+
+		std::atomic< std::uint64_t >	m_count{ 0 };
+		std::atomic< std::uint64_t >	m_sum{ 0 };
+		std::atomic< std::uint64_t >	m_max{ 0 };
+		std::atomic< std::uint64_t >	m_buckets[ histogram::buckets ];
+	};
+
+	std::chrono::steady_clock::time_point	m_prepared;
+	std::chrono::steady_clock::time_point	m_checked;
+	int										m_poll_timeout	= -1;
+	std::atomic< std::uint64_t >			m_iterations{ 0 };
+	std::atomic< std::uint64_t >			m_slow_callbacks{ 0 };
+	recorder								m_lag;
+	recorder								m_queue_depth;
+	recorder								m_queue_wait;
+	std::chrono::microseconds				m_threshold{ 0 };
+	slow_callback_f							m_slow_callback;
+};
+
+
+std::uint64_t
+runloop::histogram::percentile( double p ) const
+{
+	std::uint64_t ret = 0;
+
+	if ( count > 0 )
+	{
+		auto			target	= static_cast< std::uint64_t >( p * static_cast< double >( count ) );
+		std::uint64_t	seen	= 0;
+
+		for ( auto i = 0u; i < buckets; ++i )
+		{
+			seen += bucket[ i ];
+
+			if ( ( seen > target ) || ( seen == count ) )
+			{
+				ret = ( i == 0 ) ? 0 : std::min( std::uint64_t( 1 ) << i, max );
+				break;
+			}
+		}
+	}
+
+	return ret;
+}
+
 NODEOZE_DEFINE_SINGLETON( runloop )
 
 runloop*
@@ -154,15 +275,119 @@ runloop::create()
 
 runloop::runloop()
 :
-	m_handle( new uv_async_s )
+	runloop( uv_default_loop(), false )
 {
-	uv_async_init( uv_default_loop(), reinterpret_cast< uv_async_t* > ( m_handle ), reinterpret_cast< uv_async_cb >( on_wakeup ) );
+}
+
+
+runloop::runloop( void *loop, bool owns_loop )
+:
+	m_loop( loop ),
+	m_owns_loop( owns_loop ),
+	m_handle( new uv_async_s ),
+	m_prepare( new uv_prepare_t ),
+	m_check( new uv_check_t ),
+	m_microtask_head( 0 ),
+	m_free_events( nullptr ),
+	m_events_live( 0 ),
+	m_events_pooled( 0 ),
+	m_instrumented( false )
+{
+	auto native		= reinterpret_cast< uv_loop_t* >( m_loop );
+	auto prepare	= reinterpret_cast< uv_prepare_t* >( m_prepare );
+	auto check		= reinterpret_cast< uv_check_t* >( m_check );
+
+	uv_async_init( native, reinterpret_cast< uv_async_t* > ( m_handle ), reinterpret_cast< uv_async_cb >( on_wakeup ) );
 	reinterpret_cast< uv_async_t* >( m_handle )->data = this;
+
+	// the prepare/check pair brackets every poll: microtasks are drained on
+	// both sides, and instrumentation measures lag from them. Unreferenced,
+	// so that they never keep the loop running on their own.
+
+	uv_prepare_init( native, prepare );
+	prepare->data = this;
+	uv_prepare_start( prepare, reinterpret_cast< uv_prepare_cb >( on_prepare ) );
+	uv_unref( reinterpret_cast< uv_handle_t* >( prepare ) );
+
+	uv_check_init( native, check );
+	check->data = this;
+	uv_check_start( check, reinterpret_cast< uv_check_cb >( on_check ) );
+	uv_unref( reinterpret_cast< uv_handle_t* >( check ) );
 }
 
 
 runloop::~runloop()
 {
+	m_timers.reset();
+	instrument( false );
+
+	// a loop we don't own outlives us, so it must not call back into this
+
+	uv_prepare_stop( reinterpret_cast< uv_prepare_t* >( m_prepare ) );
+	uv_check_stop( reinterpret_cast< uv_check_t* >( m_check ) );
+
+	if ( m_owns_loop )
+	{
+		auto loop = reinterpret_cast< uv_loop_t* >( m_loop );
+
+		uv_close( reinterpret_cast< uv_handle_t* >( m_handle ), []( uv_handle_t *handle )
+		{
+			delete reinterpret_cast< uv_async_t* >( handle );
+		} );
+
+		uv_close( reinterpret_cast< uv_handle_t* >( m_prepare ), []( uv_handle_t *handle )
+		{
+			delete reinterpret_cast< uv_prepare_t* >( handle );
+		} );
+
+		uv_close( reinterpret_cast< uv_handle_t* >( m_check ), []( uv_handle_t *handle )
+		{
+			delete reinterpret_cast< uv_check_t* >( handle );
+		} );
+
+		// one pass to run the close callback; blocking here would hang on
+		// any handle the owner failed to close
+
+		uv_run( loop, UV_RUN_NOWAIT );
+
+		if ( uv_loop_close( loop ) == 0 )
+		{
+			delete loop;
+		}
+	}
+
+	while ( m_free_events )
+	{
+		auto mem = m_free_events;
+		m_free_events = *reinterpret_cast< void** >( mem );
+		::operator delete( mem );
+	}
+}
+
+
+runloop&
+runloop::current()
+{
+	return t_current ? *t_current : shared();
+}
+
+
+timer_wheel&
+runloop::timers()
+{
+	if ( !m_timers )
+	{
+		m_timers.reset( new timer_wheel( *this ) );
+	}
+
+	return *m_timers;
+}
+
+
+uv_loop_t*
+libuv::current_loop()
+{
+	return reinterpret_cast< uv_loop_t* >( runloop::current().native() );
 }
 
 
@@ -172,9 +397,9 @@ runloop::create( native_socket_type fd, int mask )
 	uv_event	*event;
 	int			err;
 	
-	event = new uv_event( uv_event::type_t::poll );
-	err = uv_poll_init( uv_default_loop(), &event->m_data.poll.m_handle, fd );
-	ncheck_error_action( err == 0, delete event; event = nullptr, exit );
+	event = new ( allocate_event() ) uv_event( uv_event::type_t::poll, this );
+	err = uv_poll_init( reinterpret_cast< uv_loop_t* >( m_loop ), &event->m_data.poll.m_handle, fd );
+	ncheck_error_action( err == 0, free_event( event ); event = nullptr, exit );
 	
 	event->m_data.poll.m_handle.data = event;
 	event->m_data.poll.m_events = 0;
@@ -201,9 +426,9 @@ runloop::create( std::chrono::milliseconds msec )
 	uv_event	*event;
 	int			err;
 	
-	event = new uv_event( uv_event::type_t::timer );
-	err = uv_timer_init( uv_default_loop(), &event->m_data.timer.m_handle );
-	ncheck_error_action( err == 0, delete event; event = nullptr, exit );
+	event = new ( allocate_event() ) uv_event( uv_event::type_t::timer, this );
+	err = uv_timer_init( reinterpret_cast< uv_loop_t* >( m_loop ), &event->m_data.timer.m_handle );
+	ncheck_error_action( err == 0, free_event( event ); event = nullptr, exit );
 	
 	event->m_data.timer.m_handle.data	= event;
 	event->m_data.timer.m_msec			= msec.count();
@@ -223,10 +448,10 @@ runloop::create( const filesystem::path &path )
 	uv_event	*event;
 	int			err;
 	
-	event = new uv_event( uv_event::type_t::path );
+	event = new ( allocate_event() ) uv_event( uv_event::type_t::path, this );
 	event->m_data.path.m_path = path;
-	err = uv_fs_event_init( uv_default_loop(), &event->m_data.path.m_handle );
-	ncheck_error_action( err == 0, delete event; event = nullptr, exit );
+	err = uv_fs_event_init( reinterpret_cast< uv_loop_t* >( m_loop ), &event->m_data.path.m_handle );
+	ncheck_error_action( err == 0, free_event( event ); event = nullptr, exit );
 	
 exit:
 
@@ -240,7 +465,7 @@ runloop::create( HANDLE h )
 {
 	uv_event *event;
 
-	event = new uv_event( uv_event::type_t::handle );
+	event = new ( allocate_event() ) uv_event( uv_event::type_t::handle, this );
 	event->m_data.handle.m_thread	= nullptr;
 	event->m_data.handle.m_handle	= h;
 	event->m_data.handle.m_stop		= CreateEvent( nullptr, FALSE, FALSE, nullptr );
@@ -340,9 +565,9 @@ runloop::schedule_oneshot_timer( std::chrono::milliseconds msec, event_f func )
 	uv_event	*event;
 	int			err;
 	
-	event = new uv_event( uv_event::type_t::timer );
-	err = uv_timer_init( uv_default_loop(), &event->m_data.timer.m_handle );
-	ncheck_error_action( err == 0, delete event; event = nullptr, exit );
+	event = new ( allocate_event() ) uv_event( uv_event::type_t::timer, this );
+	err = uv_timer_init( reinterpret_cast< uv_loop_t* >( m_loop ), &event->m_data.timer.m_handle );
+	ncheck_error_action( err == 0, free_event( event ); event = nullptr, exit );
 	
 	event->m_data.timer.m_handle.data	= event;
 	event->m_data.timer.m_msec			= msec.count();
@@ -430,57 +655,45 @@ runloop::cancel( event e )
 	
 	ncheck_error( event, exit );
 	
-	if ( event->m_active )
+	// a suspended event still owns its libuv handle, so close it regardless
+	// of whether it is active
+
+	switch ( event->m_type )
 	{
-		switch ( event->m_type )
+		case uv_event::type_t::poll:
 		{
-			case uv_event::type_t::poll:
-			{
-				uv_poll_stop( &event->m_data.poll.m_handle );
-				uv_close( reinterpret_cast< uv_handle_t* >( event ), []( uv_handle_t* handle )
-				{
-					uv_event *event = reinterpret_cast< uv_event* >( handle );
-					assert( event );
-					delete event;
-				} );
-			}
-			break;
-			
-			case uv_event::type_t::timer:
-			{
-				uv_timer_stop( &event->m_data.timer.m_handle );
-				uv_close( reinterpret_cast< uv_handle_t* >( event ), []( uv_handle_t* handle )
-				{
-					uv_event *event = reinterpret_cast< uv_event* >( handle );
-					assert( event );
-					delete event;
-				} );
-			}
-			break;
-			
-			case uv_event::type_t::path:
-			{
-				uv_fs_event_stop( &event->m_data.path.m_handle );
-				uv_close( reinterpret_cast< uv_handle_t* >( event ), []( uv_handle_t *handle )
-				{
-					uv_event *event = reinterpret_cast< uv_event* >( handle );
-					assert( event );
-					delete event;
-				} );
-			}
-			break;
+			uv_poll_stop( &event->m_data.poll.m_handle );
+			uv_close( reinterpret_cast< uv_handle_t* >( event ), reinterpret_cast< uv_close_cb >( on_close ) );
+		}
+		break;
+		
+		case uv_event::type_t::timer:
+		{
+			uv_timer_stop( &event->m_data.timer.m_handle );
+			uv_close( reinterpret_cast< uv_handle_t* >( event ), reinterpret_cast< uv_close_cb >( on_close ) );
+		}
+		break;
+		
+		case uv_event::type_t::path:
+		{
+			uv_fs_event_stop( &event->m_data.path.m_handle );
+			uv_close( reinterpret_cast< uv_handle_t* >( event ), reinterpret_cast< uv_close_cb >( on_close ) );
+		}
+		break;
 
 #if defined( WIN32 )
-			case uv_event::type_t::handle:
+		case uv_event::type_t::handle:
+		{
+			if ( event->m_data.handle.m_thread != nullptr )
 			{
 				SetEvent( event->m_data.handle.m_stop );
 				event->m_data.handle.m_thread->join();
 				delete event->m_data.handle.m_thread;
 				event->m_data.handle.m_thread = nullptr;
 			}
-			break;
-#endif
 		}
+		break;
+#endif
 	}
 	
 exit:
@@ -489,28 +702,73 @@ exit:
 }
 
 
+void*
+runloop::allocate_event()
+{
+	void *mem;
+
+	if ( m_free_events )
+	{
+		mem = m_free_events;
+		m_free_events = *reinterpret_cast< void** >( mem );
+		m_events_pooled.store( m_events_pooled.load( std::memory_order_relaxed ) - 1, std::memory_order_relaxed );
+	}
+	else
+	{
+		mem = ::operator new( sizeof( uv_event ) );
+	}
+
+	m_events_live.store( m_events_live.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+
+	return mem;
+}
+
+
+void
+runloop::free_event( void *e )
+{
+	// destroy now rather than on reuse, so callbacks release their captures
+
+	reinterpret_cast< uv_event* >( e )->~uv_event();
+
+	m_events_live.store( m_events_live.load( std::memory_order_relaxed ) - 1, std::memory_order_relaxed );
+
+	if ( m_events_pooled.load( std::memory_order_relaxed ) < max_pooled_events )
+	{
+		*reinterpret_cast< void** >( e ) = m_free_events;
+		m_free_events = e;
+		m_events_pooled.store( m_events_pooled.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+	}
+	else
+	{
+		::operator delete( e );
+	}
+}
+
+
 void
 runloop::run( mode_t how )
 {
+	drain_microtasks();
 	drain_dispatch_queue();
 
 	switch ( how )
 	{
 		case mode_t::nowait:
 		{
-			uv_run( uv_default_loop(), UV_RUN_NOWAIT );
+			uv_run( reinterpret_cast< uv_loop_t* >( m_loop ), UV_RUN_NOWAIT );
 		}
 		break;
 
 		case mode_t::once:
 		{
-			uv_run( uv_default_loop(), UV_RUN_ONCE );
+			uv_run( reinterpret_cast< uv_loop_t* >( m_loop ), UV_RUN_ONCE );
 		}
 		break;
 
 		case mode_t::normal:
 		{
-			uv_run( uv_default_loop(), UV_RUN_DEFAULT );
+			uv_run( reinterpret_cast< uv_loop_t* >( m_loop ), UV_RUN_DEFAULT );
 		}
 		break;
 	}
@@ -520,9 +778,23 @@ runloop::run( mode_t how )
 void
 runloop::dispatch( dispatch_f f )
 {
-	m_queue.emplace( std::move( f ) );
-	auto ret = uv_async_send( reinterpret_cast< uv_async_t* >( m_handle ) );
-	ncheck_error( ret == 0, exit );
+	dispatch( std::move( f ), nullptr );
+}
+
+
+void
+runloop::dispatch( dispatch_f f, const char *tag )
+{
+	auto enqueued = is_instrumented() ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+	// only the push that makes the queue non-empty needs to wake the loop;
+	// any later ones are picked up by the same drain
+
+	if ( m_queue.push( dispatch_item{ std::move( f ), tag, enqueued } ) )
+	{
+		auto ret = uv_async_send( reinterpret_cast< uv_async_t* >( m_handle ) );
+		ncheck_error( ret == 0, exit );
+	}
 
 exit:
 
@@ -530,10 +802,96 @@ exit:
 }
 
 
+void
+runloop::next_tick( microtask_f f )
+{
+	m_microtasks.emplace_back( std::move( f ) );
+}
+
+
+void
+runloop::instrument( bool enable )
+{
+	if ( enable && !m_instrumentation )
+	{
+		m_instrumentation.reset( new instrumentation );
+	}
+
+	if ( enable && !is_instrumented() )
+	{
+		m_instrumentation->m_checked = std::chrono::steady_clock::time_point();
+	}
+
+	m_instrumented.store( enable, std::memory_order_release );
+}
+
+
+void
+runloop::trace_slow_callbacks( std::chrono::microseconds threshold, slow_callback_f func )
+{
+	if ( !m_instrumentation )
+	{
+		m_instrumentation.reset( new instrumentation );
+	}
+
+	m_instrumentation->m_threshold		= threshold;
+	m_instrumentation->m_slow_callback	= std::move( func );
+}
+
+
+runloop::health
+runloop::snapshot() const
+{
+	health ret;
+
+	ret.events_live		= m_events_live.load( std::memory_order_relaxed );
+	ret.events_pooled	= m_events_pooled.load( std::memory_order_relaxed );
+
+	// the instrumentation object is created on the loop thread and never
+	// released before the loop itself, so a reader only needs to see it
+
+	if ( m_instrumented.load( std::memory_order_acquire ) && m_instrumentation )
+	{
+		ret.iterations		= m_instrumentation->m_iterations.load( std::memory_order_relaxed );
+		ret.lag				= m_instrumentation->m_lag.snapshot();
+		ret.queue_depth		= m_instrumentation->m_queue_depth.snapshot();
+		ret.queue_wait		= m_instrumentation->m_queue_wait.snapshot();
+		ret.slow_callbacks	= m_instrumentation->m_slow_callbacks.load( std::memory_order_relaxed );
+	}
+
+	return ret;
+}
+
+
+template< class Func >
+void
+runloop::invoke( const char *tag, Func &&func )
+{
+	if ( !is_instrumented() || !m_instrumentation->m_slow_callback )
+	{
+		func();
+	}
+	else
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		func();
+
+		auto elapsed = std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now() - start );
+
+		if ( ( elapsed >= m_instrumentation->m_threshold ) && m_instrumentation->m_slow_callback )
+		{
+			m_instrumentation->m_slow_callbacks.fetch_add( 1, std::memory_order_relaxed );
+			m_instrumentation->m_slow_callback( tag, elapsed );
+		}
+	}
+}
+
+
 void
 runloop::stop()
 {
-	uv_stop( uv_default_loop() );
+	uv_stop( reinterpret_cast< uv_loop_t* >( m_loop ) );
 }
 
 
@@ -549,6 +907,75 @@ runloop::on_wakeup( void *v, int status )
 }
 
 
+void
+runloop::on_close( void *v )
+{
+	auto event = reinterpret_cast< uv_event* >( v );
+
+	assert( event );
+	event->m_owner->free_event( event );
+}
+
+
+void
+runloop::on_prepare( void *v )
+{
+	auto	handle	= reinterpret_cast< uv_prepare_t* >( v );
+	auto	self	= reinterpret_cast< runloop* >( handle->data );
+
+	self->drain_microtasks();
+
+	if ( !self->is_instrumented() )
+	{
+		return;
+	}
+
+	auto	inst	= self->m_instrumentation.get();
+	auto	now		= std::chrono::steady_clock::now();
+
+	// lag is the time spent in callbacks between polls: from the last check
+	// to this prepare, plus however long the last poll overran its timeout
+	// (the I/O callbacks run inside the poll). With no timeout the I/O
+	// callbacks cannot be told apart from waiting, so lag is a lower bound.
+
+	if ( inst->m_checked != std::chrono::steady_clock::time_point() )
+	{
+		auto lag = usec_since( inst->m_checked, now );
+
+		if ( inst->m_poll_timeout >= 0 )
+		{
+			auto polled		= usec_since( inst->m_prepared, inst->m_checked );
+			auto allowed	= static_cast< std::uint64_t >( inst->m_poll_timeout ) * 1000;
+
+			lag += ( polled > allowed ) ? polled - allowed : 0;
+		}
+
+		inst->m_lag.record( lag );
+	}
+
+	inst->m_iterations.fetch_add( 1, std::memory_order_relaxed );
+	inst->m_prepared		= now;
+	inst->m_poll_timeout	= uv_backend_timeout( handle->loop );
+}
+
+
+void
+runloop::on_check( void *v )
+{
+	auto	handle	= reinterpret_cast< uv_check_t* >( v );
+	auto	self	= reinterpret_cast< runloop* >( handle->data );
+
+	// stamp first, so that draining counts towards lag
+
+	if ( self->is_instrumented() )
+	{
+		self->m_instrumentation->m_checked = std::chrono::steady_clock::now();
+	}
+
+	self->drain_microtasks();
+}
+
+
 void
 runloop::on_poll( void *v, int status, int events )
 {
@@ -557,7 +984,14 @@ runloop::on_poll( void *v, int status, int events )
 	
 	uv_event *event = reinterpret_cast< uv_event* >( v );
 	
-	event->m_data.poll.m_callback( event );
+	auto &self = runloop::current();
+
+	self.invoke( "poll", [=]()
+	{
+		event->m_data.poll.m_callback( event );
+	} );
+
+	self.drain_microtasks();
 }
 
 	
@@ -568,12 +1002,19 @@ runloop::on_timer( void *v, int status )
 	
 	uv_event *event = reinterpret_cast< uv_event* >( v );
 	
-	event->m_data.timer.m_callback( event );
+	auto &self = runloop::current();
+
+	self.invoke( "timer", [=]()
+	{
+		event->m_data.timer.m_callback( event );
+	} );
 	
 	if ( !event->m_data.timer.m_repeat )
 	{
-		runloop::shared().cancel( event );
+		self.cancel( event );
 	}
+
+	self.drain_microtasks();
 }
 
 
@@ -585,7 +1026,15 @@ runloop::on_path( void *v, const char *filename, int events, int status )
 	if ( filename )
 	{
 		auto absolute = event->m_data.path.m_path / filesystem::path( filename );
-		event->m_data.path.m_callback( event, absolute, events, status );
+
+		auto &self = runloop::current();
+
+		self.invoke( "path", [&]()
+		{
+			event->m_data.path.m_callback( event, absolute, events, status );
+		} );
+
+		self.drain_microtasks();
 	}
 }
 	
@@ -593,10 +1042,149 @@ runloop::on_path( void *v, const char *filename, int events, int status )
 void
 runloop::drain_dispatch_queue()
 {
-	dispatch_f dispatch;
+	// one batch per wakeup; anything dispatched meanwhile found the queue
+	// empty and has sent a wakeup of its own
+
+	if ( !is_instrumented() )
+	{
+		m_queue.consume_all( [this]( dispatch_item &item )
+		{
+			item.m_func();
+			drain_microtasks();
+		} );
+	}
+	else
+	{
+		auto inst = m_instrumentation.get();
+
+		auto count = m_queue.consume_all( [this, inst]( dispatch_item &item )
+		{
+			if ( item.m_enqueued != std::chrono::steady_clock::time_point() )
+			{
+				inst->m_queue_wait.record( usec_since( item.m_enqueued, std::chrono::steady_clock::now() ) );
+			}
+
+			invoke( item.m_tag ? item.m_tag : "dispatch", item.m_func );
+			drain_microtasks();
+		} );
+
+		inst->m_queue_depth.record( count );
+	}
+}
+
+
+void
+runloop::drain_microtasks()
+{
+	// by index, as a microtask may queue more (and a nested drain may run
+	// them first); the vector keeps its capacity, so steady state never
+	// allocates
+
+	while ( m_microtask_head < m_microtasks.size() )
+	{
+		auto func = std::move( m_microtasks[ m_microtask_head++ ] );
+
+		invoke( "microtask", func );
+	}
+
+	m_microtasks.clear();
+	m_microtask_head = 0;
+}
+
+
+runloop_group::runloop_group( std::size_t count )
+:
+	m_next( 0 )
+{
+	count = std::max< std::size_t >( count, 1 );
+
+	m_members.resize( count );
+
+	for ( auto &member : m_members )
+	{
+		auto loop	= new uv_loop_t;
+		auto err	= std::error_code( uv_loop_init( loop ), libuv::error_category() );
+
+		// no thread is running yet, so the loops made so far close with
+		// m_members as the exception unwinds
+
+		if ( err )
+		{
+			delete loop;
+			throw std::system_error( err );
+		}
+
+		member.m_loop.reset( new runloop( loop, true ) );
+	}
+
+	for ( auto &member : m_members )
+	{
+		auto rl = member.m_loop.get();
+
+		member.m_thread = std::thread( [rl]()
+		{
+			t_current = rl;
+
+			// the wakeup handle keeps the loop alive until stop()
+
+			rl->run();
+			t_current = nullptr;
+		} );
+	}
+}
+
+
+runloop_group::~runloop_group()
+{
+	stop();
+}
+
+
+runloop&
+runloop_group::next()
+{
+	return at( m_next.fetch_add( 1, std::memory_order_relaxed ) % m_members.size() );
+}
+
+
+void
+runloop_group::dispatch_all( std::function< void ( runloop& ) > f )
+{
+	for ( auto &member : m_members )
+	{
+		auto rl = member.m_loop.get();
+
+		rl->dispatch( [rl, f]()
+		{
+			f( *rl );
+		} );
+	}
+}
+
+
+void
+runloop_group::stop()
+{
+	// uv_stop() is not thread safe, so each loop stops itself
 
-	while ( m_queue.try_pop( dispatch ) )
+	for ( auto &member : m_members )
 	{
-		dispatch();
+		if ( member.m_thread.joinable() )
+		{
+			auto rl = member.m_loop.get();
+
+			rl->dispatch( [rl]()
+			{
+				rl->stop();
+			} );
+		}
+	}
+
+	for ( auto &member : m_members )
+	{
+		if ( member.m_thread.joinable() )
+		{
+			member.m_thread.join();
+		}
 	}
 }
@@ -1,6 +1,9 @@
 #include <nodeoze/stream.h>
 #include <nodeoze/stream2.h>
 #include <nodeoze/test.h>
+#include <deque>
+#include <string>
+#include <vector>
 
 using namespace nodeoze;
 
@@ -30,7 +33,7 @@ stream::base::~base()
 
 stream::readable::readable()
 {
-	on( "newListener", [=]( const char *key, std::size_t num_listeners ) mutable
+	on( "newListener", [this]( const char *key, std::size_t num_listeners ) mutable
 	{
 		if ( ( num_listeners == 1 ) && ( strcmp( key, "data" ) == 0 ) )
 		{
@@ -39,7 +42,7 @@ stream::readable::readable()
 
 	} );
 
-	on( "removeListener", [=]( const char *key, std::size_t num_listeners ) mutable
+	on( "removeListener", [this]( const char *key, std::size_t num_listeners ) mutable
 	{
 		if ( ( num_listeners == 0 ) && ( strcmp( key, "data" ) == 0 ) )
 		{
@@ -91,22 +94,27 @@ stream::writable::~writable()
 bool
 stream::writable::write( buffer b, std::function< void () > cb )
 {
-	auto ok = true;
+	m_buffered += b.size();
+	m_queue.emplace( std::move( b ) );
+
+	auto ok = ( m_buffered < m_highwater_mark );
+
+	if ( !ok )
+	{
+		m_need_drain = true;
+	}
 
 	if ( !m_writing )
 	{
-		start_write( b );
+		m_writing = true;
+
+		start_write();
 
 		once( "drain", cb );
 	}
-	else
+	else if ( m_in_flight < m_window )
 	{
-		m_queue.emplace( std::move( b ) );
-
-		if ( m_queue.size() > 5 )
-		{
-			ok = false;
-		}
+		start_write();
 	}
 
 	return ok;
@@ -126,40 +134,127 @@ stream::writable::end()
 
 
 void
-stream::writable::start_write( buffer b )
+stream::writable::start_write()
 {
-	m_writing = true;
-
-	really_write( b )
-	.then( [=]() mutable
-	{
-	},
-	[=]( auto err ) mutable
-	{
-        emit( "error", err );
-	} )
-	.finally( [=]() mutable
+	while ( !m_queue.empty() && ( m_in_flight < m_window ) )
 	{
-		if ( m_queue.size() > 0 )
-		{
-			auto buf = m_queue.front();
+		std::size_t bytes = 0;
 
-			m_queue.pop();
+		// always take at least one buffer, however large
 
-			start_write( buf );
+		while ( !m_queue.empty() && ( m_batch.size() < writev_max_buffers ) && ( m_batch.empty() || ( bytes + m_queue.front().size() <= writev_max_bytes ) ) )
+		{
+			bytes += m_queue.front().size();
+			m_batch.emplace_back( std::move( m_queue.front() ) );
+			m_queue.pop();
 		}
-		else
+
+		m_in_flight++;
+
+		really_writev( m_batch )
+		.then( []()
 		{
-			m_writing = false;
+		},
+		[this]( auto err )
+		{
+			emit( "error", err );
+		} )
+		.finally( [this, bytes]()
+		{
+			write_done( bytes );
+		} );
+
+		m_batch.clear();
+	}
+}
 
-			emit( "drain" );
 
-			if ( m_ended )
-			{
-				emit( "finish" );
-			}
+void
+stream::writable::write_done( std::size_t bytes )
+{
+	m_in_flight--;
+	m_buffered -= bytes;
+
+	if ( !m_queue.empty() )
+	{
+		start_write();
+	}
+
+	// a write that settles synchronously re-enters here from start_write(),
+	// so the nested call may already have gone idle and emitted for us
+
+	if ( ( m_in_flight == 0 ) && m_queue.empty() && m_writing )
+	{
+		m_writing		= false;
+		m_need_drain	= false;
+
+		emit( "drain" );
+
+		if ( m_ended )
+		{
+			emit( "finish" );
 		}
-	} );
+	}
+	else if ( m_need_drain && ( m_buffered <= m_lowwater_mark ) )
+	{
+		m_need_drain = false;
+
+		emit( "drain" );
+	}
+}
+
+
+promise< void >
+stream::writable::really_writev( std::vector< buffer > &bufs )
+{
+	if ( bufs.size() == 1 )
+	{
+		auto b = std::move( bufs.front() );
+
+		bufs.clear();
+
+		return really_write( std::move( b ) );
+	}
+
+	auto ret	= promise< void >();
+	auto queue	= std::make_shared< std::queue< buffer > >();
+
+	for ( auto &b : bufs )
+	{
+		queue->emplace( std::move( b ) );
+	}
+
+	bufs.clear();
+
+	write_each( std::move( queue ), ret );
+
+	return ret;
+}
+
+
+void
+stream::writable::write_each( std::shared_ptr< std::queue< buffer > > bufs, promise< void > ret )
+{
+	if ( bufs->empty() )
+	{
+		ret.resolve();
+	}
+	else
+	{
+		auto b = std::move( bufs->front() );
+
+		bufs->pop();
+
+		really_write( std::move( b ) )
+		.then( [this, bufs, ret]() mutable
+		{
+			write_each( bufs, ret );
+		},
+		[ret]( std::error_code err ) mutable
+		{
+			ret.reject( err );
+		} );
+	}
 }
 
 
@@ -211,6 +306,43 @@ stream::dual::~dual()
 {
 }
 
+class held_writable : public stream::writable
+{
+public:
+
+	virtual promise< void >
+	really_write( buffer b )
+	{
+		auto ret = promise< void >();
+
+		m_written.emplace_back( b.to_string() );
+
+		// like a socket, an empty write settles at once
+
+		if ( b.size() == 0 )
+		{
+			ret.resolve();
+		}
+		else
+		{
+			m_pending.emplace_back( ret );
+		}
+
+		return ret;
+	}
+
+	void
+	complete()
+	{
+		auto ret = m_pending.front();
+		m_pending.pop_front();
+		ret.resolve();
+	}
+
+	std::deque< promise< void > >	m_pending;
+	std::vector< std::string >		m_written;
+};
+
 TEST_CASE( "nodeoze/smoke/stream" )
 {
 	SUBCASE( "pipe" )
@@ -223,6 +355,75 @@ TEST_CASE( "nodeoze/smoke/stream" )
 		readable->push( "hello world" );
 	}
 
+	SUBCASE( "water marks" )
+	{
+		auto writable	= std::make_shared< held_writable >();
+		auto drains		= 0;
+
+		writable->set_highwater_mark( 10 );
+		writable->set_lowwater_mark( 4 );
+		writable->set_write_window( 2 );
+
+		writable->on( "drain", [&]()
+		{
+			drains++;
+		} );
+
+		CHECK( writable->write( "aaaa" ) );
+		CHECK( writable->write( "bbbb" ) );
+		CHECK( !writable->write( "cccc" ) );
+		CHECK( writable->buffered() == 12 );
+
+		// the window holds two writes; the third waits
+
+		REQUIRE( writable->m_pending.size() == 2 );
+
+		writable->complete();
+		CHECK( writable->buffered() == 8 );
+		CHECK( drains == 0 );
+		REQUIRE( writable->m_pending.size() == 2 );
+
+		writable->complete();
+		CHECK( writable->buffered() == 4 );
+		CHECK( drains == 1 );
+
+		writable->complete();
+		CHECK( writable->buffered() == 0 );
+		CHECK( drains == 2 );
+
+		CHECK( writable->m_written == std::vector< std::string >{ "aaaa", "bbbb", "cccc" } );
+	}
+
+	SUBCASE( "synchronous completion" )
+	{
+		auto writable	= std::make_shared< held_writable >();
+		auto drains		= 0;
+		auto finishes	= 0;
+
+		writable->on( "drain", [&]()
+		{
+			drains++;
+		} );
+
+		writable->on( "finish", [&]()
+		{
+			finishes++;
+		} );
+
+		writable->write( "aaaa" );
+		writable->write( "" );
+		writable->end();
+
+		REQUIRE( writable->m_pending.size() == 1 );
+
+		// completing the first starts the empty write, which settles inside the completion
+
+		writable->complete();
+
+		CHECK( drains == 1 );
+		CHECK( finishes == 1 );
+	}
+
 	SUBCASE( "int" )
 	{
 		nodeoze::ostringstream os;
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2013-2017, Collobos Software Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <nodeoze/thread_pool.h>
+#include <algorithm>
+
+using namespace nodeoze;
+
+static thread_local thread_pool	*t_pool		= nullptr;
+static thread_local std::size_t	t_worker	= 0;
+
+NODEOZE_DEFINE_SINGLETON( thread_pool )
+
+thread_pool*
+thread_pool::create()
+{
+	return new thread_pool;
+}
+
+
+thread_pool::thread_pool( std::size_t threads, std::size_t queue_depth )
+:
+	m_queue_depth( std::max< std::size_t >( queue_depth, 1 ) ),
+	m_next( 0 ),
+	m_pending( 0 ),
+	m_stopping( false )
+{
+	threads = std::max< std::size_t >( threads, 1 );
+
+	for ( auto i = 0u; i < threads; ++i )
+	{
+		m_workers.emplace_back( new worker );
+	}
+
+	for ( auto i = 0u; i < threads; ++i )
+	{
+		m_workers[ i ]->m_thread = std::thread( [this, i]()
+		{
+			t_pool		= this;
+			t_worker	= i;
+			run( i );
+			t_pool		= nullptr;
+		} );
+	}
+}
+
+
+thread_pool::~thread_pool()
+{
+	stop();
+}
+
+
+std::error_code
+thread_pool::post( task_f task )
+{
+	std::error_code err;
+
+	{
+		std::lock_guard< std::mutex > lock( m_sleep_mutex );
+
+		if ( m_stopping )
+		{
+			err = make_error_code( std::errc::operation_canceled );
+			goto exit;
+		}
+	}
+
+	if ( t_pool == this )
+	{
+		// keep work spawned by a task local to its worker; spill to the peers only when that deque is full
+
+		if ( try_push( *m_workers[ t_worker ], task ) )
+		{
+			goto wakeup;
+		}
+	}
+
+	{
+		auto start = m_next.fetch_add( 1, std::memory_order_relaxed );
+
+		for ( auto i = 0u; i < m_workers.size(); ++i )
+		{
+			if ( try_push( *m_workers[ ( start + i ) % m_workers.size() ], task ) )
+			{
+				goto wakeup;
+			}
+		}
+	}
+
+	err = make_error_code( std::errc::resource_unavailable_try_again );
+	goto exit;
+
+wakeup:
+
+	{
+		std::lock_guard< std::mutex > lock( m_sleep_mutex );
+		m_wakeup.notify_one();
+	}
+
+exit:
+
+	return err;
+}
+
+
+void
+thread_pool::stop()
+{
+	{
+		std::lock_guard< std::mutex > lock( m_sleep_mutex );
+		m_stopping = true;
+		m_wakeup.notify_all();
+	}
+
+	for ( auto &w : m_workers )
+	{
+		if ( w->m_thread.joinable() )
+		{
+			w->m_thread.join();
+		}
+	}
+}
+
+
+bool
+thread_pool::try_push( worker &w, task_f &task )
+{
+	std::lock_guard< std::mutex > lock( w.m_mutex );
+
+	if ( w.m_tasks.size() >= m_queue_depth )
+	{
+		return false;
+	}
+
+	w.m_tasks.emplace_back( std::move( task ) );
+	m_pending.fetch_add( 1, std::memory_order_release );
+
+	return true;
+}
+
+
+bool
+thread_pool::try_pop( worker &w, task_f &task )
+{
+	std::lock_guard< std::mutex > lock( w.m_mutex );
+
+	if ( w.m_tasks.empty() )
+	{
+		return false;
+	}
+
+	task = std::move( w.m_tasks.back() );
+	w.m_tasks.pop_back();
+	m_pending.fetch_sub( 1, std::memory_order_relaxed );
+
+	return true;
+}
+
+
+bool
+thread_pool::try_steal( std::size_t self, task_f &task )
+{
+	for ( auto i = 1u; i < m_workers.size(); ++i )
+	{
+		auto &victim = *m_workers[ ( self + i ) % m_workers.size() ];
+
+		std::lock_guard< std::mutex > lock( victim.m_mutex );
+
+		if ( !victim.m_tasks.empty() )
+		{
+			task = std::move( victim.m_tasks.front() );
+			victim.m_tasks.pop_front();
+			m_pending.fetch_sub( 1, std::memory_order_relaxed );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void
+thread_pool::run( std::size_t self )
+{
+	auto &me = *m_workers[ self ];
+
+	for ( ;; )
+	{
+		task_f task;
+
+		if ( try_pop( me, task ) || try_steal( self, task ) )
+		{
+			task();
+			continue;
+		}
+
+		std::unique_lock< std::mutex > lock( m_sleep_mutex );
+
+		m_wakeup.wait( lock, [&]()
+		{
+			return m_stopping || ( m_pending.load( std::memory_order_acquire ) > 0 );
+		} );
+
+		if ( m_stopping && ( m_pending.load( std::memory_order_acquire ) == 0 ) )
+		{
+			break;
+		}
+	}
+}
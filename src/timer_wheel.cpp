@@ -0,0 +1,447 @@
+/*
+ * Copyright (c) 2013-2017, Collobos Software Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <nodeoze/timer_wheel.h>
+#include <nodeoze/macros.h>
+#include <algorithm>
+#include <vector>
+#include <limits>
+#include <cassert>
+
+using namespace nodeoze;
+
+static const std::uint64_t not_armed = std::numeric_limits< std::uint64_t >::max();
+
+timer_wheel::timer_wheel( runloop &loop )
+:
+	m_loop( loop ),
+	m_event( loop.create( std::chrono::milliseconds( 0 ) ) ),
+	m_base( std::chrono::steady_clock::now() ),
+	m_now( 0 ),
+	m_armed( not_armed ),
+	m_count( 0 ),
+	m_advancing( false ),
+	m_running( false ),
+	m_free( nullptr )
+{
+	for ( auto &level : m_slots )
+	{
+		for ( auto &head : level )
+		{
+			init( head );
+		}
+	}
+}
+
+
+timer_wheel::~timer_wheel()
+{
+	m_loop.cancel( m_event );
+
+	// release the callbacks before the entries, since destroying a callback
+	// can cancel other timers on this wheel
+
+	std::vector< expire_f > funcs;
+
+	for ( auto &level : m_slots )
+	{
+		for ( auto &head : level )
+		{
+			for ( auto l = head.m_next; l != &head; l = l->m_next )
+			{
+				funcs.emplace_back( std::move( static_cast< entry* >( l )->m_func ) );
+			}
+		}
+	}
+
+	funcs.clear();
+
+	for ( auto &level : m_slots )
+	{
+		for ( auto &head : level )
+		{
+			while ( !empty( head ) )
+			{
+				auto e = static_cast< entry* >( head.m_next );
+				unlink( e );
+				delete e;
+			}
+		}
+	}
+
+	while ( m_free )
+	{
+		auto e = m_free;
+		m_free = static_cast< entry* >( e->m_next );
+		delete e;
+	}
+}
+
+
+timer_wheel::timer
+timer_wheel::schedule( std::chrono::milliseconds timeout, expire_f func )
+{
+	entry *e;
+
+	if ( m_free )
+	{
+		e		= m_free;
+		m_free	= static_cast< entry* >( e->m_next );
+	}
+	else
+	{
+		e = new entry;
+	}
+
+	auto current = now();
+
+	if ( ( m_count == 0 ) && !m_advancing )
+	{
+		// nothing is pending, so the wheel can jump straight to the present
+
+		m_now = current;
+	}
+
+	// now() truncates to the tick, which may be nearly over; counting from
+	// the next one means a timer can fire up to a tick late, never early
+
+	auto ticks = static_cast< std::uint64_t >( std::max< std::chrono::milliseconds::rep >( timeout.count(), 0 ) );
+
+	e->m_wheel		= this;
+	e->m_expires	= current + ticks + ( ticks > 0 ? 1 : 0 );
+	e->m_func		= std::move( func );
+
+	insert( e );
+	m_count++;
+
+	rearm();
+
+	return e;
+}
+
+
+void
+timer_wheel::cancel( timer t )
+{
+	auto e = reinterpret_cast< entry* >( t );
+
+	if ( e )
+	{
+		auto wheel = e->m_wheel;
+
+		assert( wheel );
+
+		unlink( e );
+		wheel->m_count--;
+		wheel->recycle( e );
+
+		// otherwise the runloop timer is left armed; an early wakeup is
+		// cheaper than re-arming on every cancel. Once the wheel is empty it
+		// must stop, or it would keep the loop alive.
+
+		if ( wheel->m_count == 0 )
+		{
+			wheel->rearm();
+		}
+	}
+}
+
+
+void
+timer_wheel::init( link &head )
+{
+	head.m_prev = &head;
+	head.m_next = &head;
+}
+
+
+bool
+timer_wheel::empty( const link &head )
+{
+	return head.m_next == &head;
+}
+
+
+void
+timer_wheel::unlink( link *l )
+{
+	l->m_prev->m_next = l->m_next;
+	l->m_next->m_prev = l->m_prev;
+	l->m_prev = l;
+	l->m_next = l;
+}
+
+
+void
+timer_wheel::append( link &head, link *l )
+{
+	l->m_prev			= head.m_prev;
+	l->m_next			= &head;
+	head.m_prev->m_next	= l;
+	head.m_prev			= l;
+}
+
+
+void
+timer_wheel::splice( link &from, link &to )
+{
+	if ( !empty( from ) )
+	{
+		from.m_next->m_prev	= to.m_prev;
+		from.m_prev->m_next	= &to;
+		to.m_prev->m_next	= from.m_next;
+		to.m_prev			= from.m_prev;
+		init( from );
+	}
+}
+
+
+std::uint64_t
+timer_wheel::now() const
+{
+	return static_cast< std::uint64_t >( std::chrono::duration_cast< std::chrono::milliseconds >( std::chrono::steady_clock::now() - m_base ).count() );
+}
+
+
+void
+timer_wheel::insert( entry *e )
+{
+	auto expires	= e->m_expires;
+	auto delta		= ( expires > m_now ) ? expires - m_now : 0;
+
+	if ( delta == 0 )
+	{
+		// due or overdue: fire on the next tick processed
+
+		append( m_slots[ 0 ][ m_now & slot_mask ], e );
+		return;
+	}
+
+	auto level = 0u;
+
+	while ( ( level < levels - 1 ) && ( delta >= ( std::uint64_t( 1 ) << ( slot_bits * ( level + 1 ) ) ) ) )
+	{
+		level++;
+	}
+
+	if ( delta >= ( std::uint64_t( 1 ) << ( slot_bits * levels ) ) )
+	{
+		// beyond the span of the wheel; park it in the furthest slot and let cascading bring it back
+
+		expires = m_now + ( std::uint64_t( 1 ) << ( slot_bits * levels ) ) - 1;
+	}
+
+	append( m_slots[ level ][ ( expires >> ( slot_bits * level ) ) & slot_mask ], e );
+}
+
+
+void
+timer_wheel::cascade( std::uint32_t level, std::uint32_t index )
+{
+	link pending;
+
+	init( pending );
+	splice( m_slots[ level ][ index ], pending );
+
+	while ( !empty( pending ) )
+	{
+		auto e = static_cast< entry* >( pending.m_next );
+		unlink( e );
+		insert( e );
+	}
+}
+
+
+void
+timer_wheel::advance( std::uint64_t target )
+{
+	m_advancing = true;
+
+	while ( m_now <= target )
+	{
+		auto index = static_cast< std::uint32_t >( m_now & slot_mask );
+
+		if ( ( index != 0 ) && empty( m_slots[ 0 ][ index ] ) )
+		{
+			// skip empty ticks, up to the next occupied one or the window
+			// boundary, so a long sleep costs a step per window rather than per tick
+
+			auto next = index + 1;
+
+			while ( ( next < slots ) && empty( m_slots[ 0 ][ next ] ) )
+			{
+				next++;
+			}
+
+			m_now = std::min( m_now + ( next - index ), target + 1 );
+			continue;
+		}
+
+		if ( index == 0 )
+		{
+			for ( auto level = 1u; level < levels; ++level )
+			{
+				auto upper = static_cast< std::uint32_t >( ( m_now >> ( slot_bits * level ) ) & slot_mask );
+
+				cascade( level, upper );
+
+				if ( upper != 0 )
+				{
+					break;
+				}
+			}
+		}
+
+		link expired;
+
+		init( expired );
+		splice( m_slots[ 0 ][ index ], expired );
+
+		// step past this tick first, so timers scheduled by the callbacks
+		// land on a later tick rather than in the list being drained
+
+		m_now++;
+
+		while ( !empty( expired ) )
+		{
+			auto e		= static_cast< entry* >( expired.m_next );
+			auto func	= std::move( e->m_func );
+
+			unlink( e );
+			m_count--;
+			recycle( e );
+
+			func();
+		}
+
+		if ( m_count == 0 )
+		{
+			m_now = std::max( m_now, target + 1 );
+			break;
+		}
+	}
+
+	m_advancing = false;
+}
+
+
+void
+timer_wheel::rearm()
+{
+	if ( m_advancing )
+	{
+		return;
+	}
+
+	if ( m_count == 0 )
+	{
+		// the runloop timer repeats, so it is stopped even when it has just fired
+
+		if ( m_running )
+		{
+			m_loop.suspend( m_event );
+			m_running = false;
+		}
+
+		m_armed = not_armed;
+
+		return;
+	}
+
+	auto wake = next_expiry();
+
+	if ( wake < m_armed )
+	{
+		auto current	= now();
+		auto delay		= ( wake > current ) ? wake - current : 0;
+
+		m_armed		= wake;
+		m_running	= true;
+
+		m_loop.schedule( m_event, std::chrono::milliseconds( delay ), [this]( runloop::event event )
+		{
+			nunused( event );
+
+			m_armed = not_armed;
+			advance( now() );
+			rearm();
+		} );
+	}
+}
+
+
+std::uint64_t
+timer_wheel::next_expiry() const
+{
+	// level 0 holds the next 64 ticks, including those that wrap into the
+	// next window
+
+	auto index = m_now & slot_mask;
+
+	for ( auto i = 0u; i < slots; ++i )
+	{
+		if ( !empty( m_slots[ 0 ][ ( index + i ) & slot_mask ] ) )
+		{
+			return m_now + i;
+		}
+	}
+
+	// otherwise wake for the first cascade that brings anything down: slot j
+	// of level l cascades on the tick whose lower bits are zero and whose
+	// level l index is j. The current index of a level has already been
+	// cascaded, so it is only reached again after a full rotation.
+
+	auto wake = std::numeric_limits< std::uint64_t >::max();
+
+	for ( auto level = 1u; level < levels; ++level )
+	{
+		auto shift		= slot_bits * level;
+		auto span		= std::uint64_t( 1 ) << shift;
+		auto current	= ( m_now >> shift ) & slot_mask;
+		auto start		= m_now & ~( span - 1 );
+
+		for ( auto i = 1u; i <= slots; ++i )
+		{
+			if ( !empty( m_slots[ level ][ ( current + i ) & slot_mask ] ) )
+			{
+				wake = std::min( wake, start + i * span );
+				break;
+			}
+		}
+	}
+
+	return wake;
+}
+
+
+void
+timer_wheel::recycle( entry *e )
+{
+	e->m_wheel	= nullptr;
+	e->m_func	= nullptr;
+	e->m_next	= m_free;
+	m_free		= e;
+}
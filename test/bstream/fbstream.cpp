@@ -121,3 +121,38 @@ TEST_CASE( "nodeoze/smoke/bstream/fbstream/write_read_ate" )
     }
     
 }
+
+TEST_CASE( "nodeoze/smoke/bstream/fbstream/async_write_read" )
+{
+    std::string expected;
+    for ( auto i = 0; i < 1000; ++i )
+    {
+        expected += std::to_string( i % 10 );
+    }
+
+    {
+        // small buffers so the writer thread sees many queued writes
+
+        auto fbuf = std::make_unique< bstream::obfilebuf >( "fbstream_test_file", bstream::open_mode::truncate, 64 );
+        fbuf->async( 3 );
+        CHECK( fbuf->is_async() );
+        bstream::ofbstream os{ std::move( fbuf ) };
+        os.putn( buffer{ expected } );
+        os.seek( seek_anchor::begin, 10 );
+        os.putn( buffer{ "abcdefghij" } );
+        os.sync();
+        os.seek( seek_anchor::end, 0 );
+        os.putn( buffer{ "tail" } );
+        os.close();
+    }
+
+    expected.replace( 10, 10, "abcdefghij" );
+    expected += "tail";
+
+    bstream::ifbstream is( "fbstream_test_file" );
+    auto fsize = is.tell( seek_anchor::end );
+    CHECK( fsize == static_cast< position_type >( expected.size() ) );
+    buffer inbuf = is.getn( fsize );
+    is.close();
+    CHECK( inbuf == buffer{ expected } );
+}
@@ -268,3 +268,29 @@ TEST_CASE( "nodeoze/smoke/bstream/poly_unique_ptrs" )
 	// CHECK( foop0->number() == foop1->number() );
 	// CHECK( foop0->real() == foop1->real() );
 }
+
+TEST_CASE( "nodeoze/smoke/bstream/poly_type_tags" )
+{
+	using context_type = bstream::context< foo, far >;
+
+	static_assert( context_type::type_tag< foo >() == 0 );
+	static_assert( context_type::type_tag< far >() == 1 );
+	static_assert( context_type::type_tag< std::string >() == bstream::invalid_tag );
+
+	context_type cntxt;
+	auto impl = cntxt.get_context_impl();
+
+	CHECK( impl->get_type_tag< foo >() == 0 );
+	CHECK( impl->get_type_tag< far >() == 1 );
+	CHECK( impl->get_type_tag< std::string >() == bstream::invalid_tag );
+	CHECK( impl->get_type_tag( std::type_index{ typeid( far ) } ) == 1 );
+
+	std::unique_ptr< far > farp = std::make_unique< foo >( "france is bacon" );
+	CHECK( impl->get_dynamic_type_tag( *farp ) == 0 );
+
+	CHECK( impl->can_downcast_ptr( 0, 1 ) );
+	CHECK( impl->can_downcast_ptr( 0, 0 ) );
+	CHECK( ! impl->can_downcast_ptr( 1, 0 ) );
+	CHECK( ! impl->can_downcast_ptr( 2, 0 ) );
+	CHECK( ! impl->can_downcast_ptr( bstream::invalid_tag, 0 ) );
+}
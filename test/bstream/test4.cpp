@@ -2,6 +2,12 @@
 #include <nodeoze/bstream.h>
 #include <nodeoze/bstream/ombstream.h>
 #include <nodeoze/bstream/imbstream.h>
+#include <nodeoze/bstream/ocbstream.h>
+#include <nodeoze/bstream/bview.h>
+#include <nodeoze/bstream/obcompressbuf.h>
+#include <nodeoze/bstream/ibcompressbuf.h>
+#include <nodeoze/bstream/obmembuf.h>
+#include <nodeoze/bstream/ibmembuf.h>
 #include <nodeoze/bstream/stdlib.h>
 #include <utility>
 #include <thread>
@@ -97,3 +103,397 @@ TEST_CASE( "nodeoze/smoke/bstream/composite_types/0" )
 
     CHECK( p0 == p1 );
 }
+
+TEST_CASE( "nodeoze/smoke/bstream/zero_copy_views" )
+{
+	bstream::context<> cntxt;
+
+	bstream::ombstream os{ 1024, cntxt };
+
+	buffer blob0{ "0123456789ABCDEF" };
+	std::string str0{ "france is bacon" };
+
+	os << blob0 << str0 << str0 << str0;
+
+	auto encoded = os.get_buffer();
+	auto begin = encoded.data();
+	auto end = encoded.data() + encoded.size();
+
+	bstream::imbstream is{ encoded, cntxt };
+
+	auto blob1 = is.read_blob_view();
+	CHECK( blob1 == blob0 );
+	CHECK( blob1.data() >= begin );
+	CHECK( blob1.data() + blob1.size() <= end );
+
+	auto alias = is.read_string_view();
+	CHECK( alias.view() == str0 );
+	CHECK( reinterpret_cast< const buffer::elem_type* >( alias.view().data() ) >= begin );
+
+	auto view = is.read_as< std::string_view >();
+	CHECK( view == str0 );
+	CHECK( reinterpret_cast< const buffer::elem_type* >( view.data() ) + view.size() <= end );
+
+	auto str1 = is.read_as< std::string >();
+	CHECK( str1 == str0 );
+
+	std::error_code err;
+	is.read_blob_view( err );
+	CHECK( err == bstream::errc::read_past_end_of_stream );
+}
+
+TEST_CASE( "nodeoze/smoke/bstream/num_arrays" )
+{
+	std::vector< double > d0;
+	std::vector< std::uint16_t > u0;
+	std::vector< std::int8_t > c0{ -1, 2, -3 };
+	for ( auto i = 0; i < 1000; ++i )
+	{
+		d0.push_back( i * 1.5 );
+		u0.push_back( static_cast< std::uint16_t >( i * 61 ) );
+	}
+
+	for ( auto order : { boost::endian::order::big, boost::endian::order::little } )
+	{
+		bstream::context<> cntxt{ true, order };
+
+		bstream::ombstream os{ 1024, cntxt };
+		os.write_num_array( d0 ).write_num_array( u0 ).write_num_array( c0 );
+		os << u0.front();
+
+		bstream::imbstream is{ os.get_buffer(), cntxt };
+
+		std::vector< double > d1;
+		std::vector< std::uint16_t > u1;
+		std::vector< std::int8_t > c1;
+		is.read_num_array( d1 ).read_num_array( u1 ).read_num_array( c1 );
+		CHECK( d0 == d1 );
+		CHECK( u0 == u1 );
+		CHECK( c0 == c1 );
+		CHECK( is.read_as< std::uint16_t >() == u0.front() );
+
+		is.position( 0 );
+		auto blob = is.read_blob();
+		CHECK( blob.size() == d0.size() * sizeof( double ) );
+		double first = 0;
+		::memcpy( &first, blob.data() + sizeof( double ), sizeof( double ) );
+		CHECK( ( first == d0[ 1 ] ) == ( order == boost::endian::order::native ) );
+
+		is.read_blob();
+
+		std::error_code err;
+		std::vector< std::uint32_t > u2;
+		is.read_num_array( u2, err );
+		CHECK( err == bstream::errc::type_error );
+	}
+}
+
+TEST_CASE( "nodeoze/smoke/bstream/fixed_order_nums" )
+{
+	bstream::context<> cntxt{ true, boost::endian::order::little };
+
+	bstream::ombstream os{ 1024, cntxt };
+	os.put_num< boost::endian::order::big >( std::uint32_t{ 0x01020304 } );
+	os.put_num( std::uint32_t{ 0x01020304 } );
+	os.put_num< boost::endian::order::little >( -2.5 );
+
+	auto buf = os.get_buffer();
+	CHECK( buf.size() == 16 );
+	CHECK( buf[ 0 ] == 0x01 );
+	CHECK( buf[ 3 ] == 0x04 );
+	CHECK( buf[ 4 ] == 0x04 );
+	CHECK( buf[ 7 ] == 0x01 );
+
+	bstream::imbstream is{ buf, cntxt };
+	CHECK( ( is.get_num< std::uint32_t, boost::endian::order::big >() ) == 0x01020304 );
+	CHECK( is.get_num< std::uint32_t >() == 0x01020304 );
+	CHECK( is.get_num< double >() == -2.5 );
+}
+
+TEST_CASE( "nodeoze/smoke/bstream/serialized_size" )
+{
+	bstream::context<> cntxt;
+
+	struct_A a0{ -7, 3.5, "zoot", { 1, 1, 2, 3, 5, 8, 13, 70000 } };
+	std::vector< std::string > strs{ "a", std::string( 300, 'b' ), std::string( 70000, 'c' ) };
+	auto shared = std::make_shared< std::string >( 5000, 'd' );
+	auto shared_pair = std::make_pair( shared, shared );
+
+	bstream::ombstream os{ 16, cntxt };
+
+	os << a0;
+	CHECK( bstream::serialized_size( a0, cntxt ) == os.size() );
+
+	os.clear();
+	os << strs;
+	CHECK( bstream::serialized_size( strs, cntxt ) == os.size() );
+
+	os.clear();
+	os << shared_pair;
+	CHECK( bstream::serialized_size( shared_pair, cntxt ) == os.size() );
+	CHECK( bstream::serialized_size( shared_pair, cntxt ) < 2 * shared->size() );
+
+	bstream::ocbstream cs{ cntxt };
+	cs << a0 << strs;
+	auto total = cs.size();
+	CHECK( total == bstream::serialized_size( a0, cntxt ) + bstream::serialized_size( strs, cntxt ) );
+	cs.position( 0 );
+	cs << a0;
+	CHECK( cs.size() == total );
+	cs.clear();
+	CHECK( cs.size() == 0 );
+}
+
+#if NODEOZE_BSTREAM_USE_PMR
+
+namespace test_4
+{
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+	std::size_t allocations = 0;
+	std::size_t largest = 0;
+
+private:
+	virtual void*
+	do_allocate( std::size_t bytes, std::size_t alignment ) override
+	{
+		++allocations;
+		largest = std::max( largest, bytes );
+		return std::pmr::new_delete_resource()->allocate( bytes, alignment );
+	}
+
+	virtual void
+	do_deallocate( void* p, std::size_t bytes, std::size_t alignment ) override
+	{
+		std::pmr::new_delete_resource()->deallocate( p, bytes, alignment );
+	}
+
+	virtual bool
+	do_is_equal( std::pmr::memory_resource const& other ) const noexcept override
+	{
+		return this == &other;
+	}
+};
+} // namespace test_4
+
+TEST_CASE( "nodeoze/smoke/bstream/untrusted_lengths" )
+{
+	bstream::context<> cntxt;
+
+	// a string header promising nearly 4GB, followed by three bytes
+
+	bstream::ombstream os{ 1024, cntxt };
+	os.put( bstream::typecode::str_32 );
+	os.put_num< boost::endian::order::big >( std::uint32_t{ 0xfffffff0 } );
+	os.putn( "abc", 3 );
+
+	bstream::imbstream is{ os.get_buffer(), cntxt };
+
+	std::error_code err;
+	try
+	{
+		is.read_as< std::string >();
+	}
+	catch ( std::system_error const& e )
+	{
+		err = e.code();
+	}
+	CHECK( err == bstream::errc::read_past_end_of_stream );
+
+	counting_resource counter;
+	is.memory_resource( &counter );
+	is.position( 0 );
+
+	err.clear();
+	try
+	{
+		is.read_as< std::pmr::string >();
+	}
+	catch ( std::system_error const& e )
+	{
+		err = e.code();
+	}
+	CHECK( err == bstream::errc::read_past_end_of_stream );
+	CHECK( counter.largest <= 2 * bstream::detail::untrusted_chunk_size );
+
+	// likewise a numeric array, read in the non-native order
+
+	bstream::context<> reversed{ true, boost::endian::order::big == boost::endian::order::native ? boost::endian::order::little : boost::endian::order::big };
+
+	bstream::ombstream os2{ 1024, reversed };
+	os2.put( bstream::typecode::bin_32 );
+	os2.put_num< boost::endian::order::big >( std::uint32_t{ 0xfffffff0 } );
+	os2.put_num( 1.5 );
+
+	bstream::imbstream is2{ os2.get_buffer(), reversed };
+
+	std::vector< double > d;
+	is2.read_num_array( d, err );
+	CHECK( err == bstream::errc::read_past_end_of_stream );
+	CHECK( d.size() <= bstream::detail::untrusted_chunk_size / sizeof( double ) );
+
+	std::uint32_t none[ 1 ];
+	CHECK( is2.get_nums( none, 0, err ) == 0 );
+	CHECK( ! err );
+}
+
+TEST_CASE( "nodeoze/smoke/bstream/memory_resource" )
+{
+	bstream::context<> cntxt;
+
+	std::pmr::vector< std::pmr::string > v0{ "zoot", std::pmr::string( 100, 'x' ) };
+	std::pmr::map< std::pmr::string, int > m0{ { std::pmr::string( 50, 'y' ), 1 }, { "z", 2 } };
+	auto sp0 = std::make_shared< std::string >( "allures" );
+
+	bstream::ombstream os{ 1024, cntxt };
+	os << v0 << m0 << sp0;
+
+	counting_resource counter;
+	std::pmr::monotonic_buffer_resource arena{ &counter };
+
+	bstream::imbstream is{ os.get_buffer(), cntxt };
+	is.memory_resource( &arena );
+	CHECK( is.memory_resource() == &arena );
+
+	auto v1 = is.read_as< std::pmr::vector< std::pmr::string > >();
+	auto m1 = is.read_as< std::pmr::map< std::pmr::string, int > >();
+	auto sp1 = is.read_as< std::shared_ptr< std::string > >();
+
+	CHECK( v1 == v0 );
+	CHECK( m1 == m0 );
+	CHECK( *sp1 == *sp0 );
+	CHECK( v1.get_allocator().resource() == &arena );
+	CHECK( v1[ 1 ].get_allocator().resource() == &arena );
+	CHECK( m1.get_allocator().resource() == &arena );
+	CHECK( counter.allocations > 0 );
+
+	sp1.reset();
+}
+
+#endif
+
+TEST_CASE( "nodeoze/smoke/bstream/bview" )
+{
+	bstream::context<> cntxt;
+
+	struct_A a0{ -7, 3.5, "zoot", { 1, 1, 2, 3, 5, 8, 13 } };
+	std::vector< std::string > names{ "a", std::string( 300, 'b' ), "c" };
+	buffer payload{ std::string( 70000, 'p' ).c_str() };
+
+	bstream::ombstream os{ 1024, cntxt };
+	os.write_map_header( 4 );
+	os << std::string_view{ "payload" } << payload;
+	os << std::string_view{ "names" } << names;
+	os << std::string_view{ "record" } << a0;
+	os << std::string_view{ "id" } << 42;
+
+	bstream::bview root{ os.get_buffer(), cntxt };
+
+	CHECK( root.get_kind() == bstream::bview::kind::map );
+	CHECK( root.size() == 4 );
+	CHECK( root[ "id" ].as< int >() == 42 );
+	CHECK( root[ "names" ].get_kind() == bstream::bview::kind::array );
+	CHECK( root[ "names" ].size() == 3 );
+	CHECK( root[ "names" ][ 2 ].string_view() == "c" );
+	CHECK( root[ "names" ][ 1 ].as< std::string >() == names[ 1 ] );
+	CHECK( root[ "record" ].as< struct_A >() == a0 );
+	CHECK( root[ "names" ].as< std::vector< std::string > >() == names );
+
+	auto blob = root[ "payload" ].blob();
+	CHECK( blob.size() == payload.size() );
+	CHECK( blob.data() > os.get_buffer().data() );
+
+	auto encoded = root[ "names" ].encoded();
+	bstream::imbstream is{ encoded, cntxt };
+	CHECK( is.read_as< std::vector< std::string > >() == names );
+	CHECK( static_cast< std::size_t >( is.position() ) == encoded.size() );
+
+	CHECK( ! root.find( "missing" ) );
+
+	std::error_code err;
+	root[ "id" ].at( 0, err );
+	CHECK( err == bstream::errc::type_error );
+	root[ "names" ].at( 3, err );
+	CHECK( err == std::errc::result_out_of_range );
+
+	bstream::bview truncated{ os.get_buffer().slice( 0, 100 ), cntxt };
+	truncated.find( "id", err );
+	CHECK( err == bstream::errc::read_past_end_of_stream );
+}
+
+TEST_CASE( "nodeoze/smoke/bstream/shared_ptr_dedup" )
+{
+	bstream::context<> cntxt;
+
+	std::vector< std::shared_ptr< std::string > > originals;
+	for ( auto i = 0; i < 200; ++i )
+	{
+		originals.push_back( std::make_shared< std::string >( std::to_string( i ) ) );
+	}
+
+	std::vector< std::shared_ptr< std::string > > graph;
+	for ( auto i = 0; i < 600; ++i )
+	{
+		graph.push_back( originals[ ( i * 7 ) % originals.size() ] );
+	}
+
+	bstream::ombstream os{ 1024, cntxt };
+	os << graph;
+
+	// temporaries that may reuse a freed address must not be deduplicated
+
+	os << std::make_shared< std::string >( "first" );
+	os << std::make_shared< std::string >( "second" );
+
+	bstream::imbstream is{ os.get_buffer(), cntxt };
+	auto graph1 = is.read_as< std::vector< std::shared_ptr< std::string > > >();
+	REQUIRE( graph1.size() == graph.size() );
+	for ( auto i = 0u; i < graph.size(); ++i )
+	{
+		CHECK( *graph1[ i ] == *graph[ i ] );
+		CHECK( graph1[ i ] == graph1[ i % originals.size() ] );
+	}
+	CHECK( *is.read_as< std::shared_ptr< std::string > >() == "first" );
+	CHECK( *is.read_as< std::shared_ptr< std::string > >() == "second" );
+
+	is.reset();
+	auto graph2 = is.read_as< std::vector< std::shared_ptr< std::string > > >();
+	CHECK( *graph2[ 599 ] == *graph[ 599 ] );
+}
+
+TEST_CASE( "nodeoze/smoke/bstream/compressbuf" )
+{
+	std::vector< std::string > records;
+	for ( auto i = 0; i < 2000; ++i )
+	{
+		records.push_back( "record number " + std::to_string( i % 50 ) );
+	}
+
+	// small buffers so both sides go through many flush/underflow cycles
+
+	bstream::obstream os{ std::make_unique< bstream::obcompressbuf >( std::make_unique< bstream::obmembuf >(), bstream::obcompressbuf::best_compression, 256 ) };
+	os << records << std::string{ "trailer" };
+	auto uncompressed_size = os.position();
+
+	auto strmbuf = os.release_streambuf();
+	auto& cbuf = static_cast< bstream::obcompressbuf& >( *strmbuf );
+	cbuf.finish();
+	CHECK( cbuf.is_finished() );
+
+	auto compressed = static_cast< bstream::obmembuf& >( cbuf.sink() ).get_buffer();
+	CHECK( compressed.size() < static_cast< std::size_t >( uncompressed_size ) / 4 );
+
+	bstream::ibstream is{ std::make_unique< bstream::ibcompressbuf >( std::make_unique< bstream::ibmembuf >( compressed ), 256 ) };
+	CHECK( is.read_as< std::vector< std::string > >() == records );
+	CHECK( is.read_as< std::string >() == "trailer" );
+
+	std::error_code err;
+	is.read_as< std::string >( err );
+	CHECK( err == bstream::errc::read_past_end_of_stream );
+
+	// a truncated compressed stream is reported, not silently shortened
+
+	bstream::ibstream truncated{ std::make_unique< bstream::ibcompressbuf >( std::make_unique< bstream::ibmembuf >( compressed.slice( 0, compressed.size() / 2 ) ) ) };
+	CHECK_THROWS( truncated.read_as< std::vector< std::string > >() );
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2013-2017, Collobos Software Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <nodeoze/concurrent.h>
+#include <nodeoze/test.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace nodeoze;
+
+TEST_CASE( "nodeoze/smoke/concurrent/mpsc_queue" )
+{
+	SUBCASE( "fifo" )
+	{
+		concurrent::mpsc_queue< int > q;
+
+		REQUIRE( q.empty() );
+		REQUIRE( q.push( 1 ) == true );
+		REQUIRE( q.push( 2 ) == false );
+		REQUIRE( q.push( 3 ) == false );
+
+		std::vector< int > got;
+		auto count = q.consume_all( [&]( int &i )
+		{
+			got.push_back( i );
+		} );
+
+		REQUIRE( count == 3 );
+		REQUIRE( got == std::vector< int >{ 1, 2, 3 } );
+		REQUIRE( q.empty() );
+		REQUIRE( q.push( 4 ) == true );
+	}
+
+	SUBCASE( "throwing consumer" )
+	{
+		concurrent::mpsc_queue< int > q;
+
+		for ( auto i = 1; i <= 5; ++i )
+		{
+			q.push( int{ i } );
+		}
+
+		std::vector< int > got;
+		auto threw = false;
+
+		try
+		{
+			q.consume_all( [&]( int &i )
+			{
+				if ( i == 3 )
+				{
+					q.push( 6 );
+					throw std::runtime_error( "consumer" );
+				}
+
+				got.push_back( i );
+			} );
+		}
+		catch ( const std::runtime_error & )
+		{
+			threw = true;
+		}
+
+		REQUIRE( threw );
+		REQUIRE( got == std::vector< int >{ 1, 2 } );
+		REQUIRE( !q.empty() );
+
+		got.clear();
+		auto count = q.consume_all( [&]( int &i )
+		{
+			got.push_back( i );
+		} );
+
+		REQUIRE( count == 3 );
+		REQUIRE( got == std::vector< int >{ 4, 5, 6 } );
+		REQUIRE( q.empty() );
+	}
+
+	SUBCASE( "multiple producers" )
+	{
+		const int producers		= 4;
+		const int per_producer	= 10000;
+
+		concurrent::mpsc_queue< std::pair< int, int > > q;
+		std::vector< std::thread > threads;
+		std::atomic< int > wakeups{ 0 };
+
+		for ( auto p = 0; p < producers; ++p )
+		{
+			threads.emplace_back( [&, p]()
+			{
+				for ( auto i = 0; i < per_producer; ++i )
+				{
+					if ( q.push( std::make_pair( p, i ) ) )
+					{
+						++wakeups;
+					}
+				}
+			} );
+		}
+
+		std::vector< int > next( producers, 0 );
+		int total = 0;
+		int batches = 0;
+
+		while ( total < producers * per_producer )
+		{
+			auto count = q.consume_all( [&]( std::pair< int, int > &item )
+			{
+				// each producer's items arrive in the order it pushed them
+
+				REQUIRE( item.second == next[ item.first ] );
+				++next[ item.first ];
+			} );
+
+			if ( count > 0 )
+			{
+				total += static_cast< int >( count );
+				++batches;
+			}
+		}
+
+		for ( auto &t : threads )
+		{
+			t.join();
+		}
+
+		REQUIRE( q.empty() );
+		REQUIRE( wakeups == batches );
+	}
+}
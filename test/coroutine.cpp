@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2013-2017, Collobos Software Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <nodeoze/promise.h>
+#include <nodeoze/test.h>
+
+#if defined( NODEOZE_HAS_COROUTINES )
+
+using namespace nodeoze;
+
+static promise< int >
+later( int val )
+{
+	promise< int > ret;
+
+	runloop::shared().dispatch( [=]() mutable
+	{
+		ret.resolve( val );
+	} );
+
+	return ret;
+}
+
+static promise< int >
+failing()
+{
+	promise< int > ret;
+
+	runloop::shared().dispatch( [=]() mutable
+	{
+		ret.reject( make_error_code( std::errc::connection_refused ) );
+	} );
+
+	return ret;
+}
+
+static promise< int >
+sum( int count )
+{
+	auto total = 0;
+
+	for ( auto i = 1; i <= count; ++i )
+	{
+		total += co_await later( i );
+	}
+
+	co_return total;
+}
+
+static promise< void >
+propagate( std::error_code &caught )
+{
+	try
+	{
+		co_await failing();
+	}
+	catch ( const std::system_error &exc )
+	{
+		caught = exc.code();
+	}
+
+	co_await failing();
+}
+
+TEST_CASE( "nodeoze/smoke/promise/coroutine" )
+{
+	SUBCASE( "await" )
+	{
+		auto p = sum( 10 );
+
+		CHECK( !p.is_finished() );
+
+		auto result = 0;
+
+		p.then( [&]( int val )
+		{
+			result = val;
+		} );
+
+		for ( auto i = 0; ( i < 1000 ) && ( result == 0 ); ++i )
+		{
+			runloop::shared().run( runloop::mode_t::nowait );
+		}
+
+		CHECK( result == 55 );
+	}
+
+	SUBCASE( "already resolved" )
+	{
+		auto ready = []() -> promise< int >
+		{
+			promise< int > p;
+
+			p.resolve( 7 );
+
+			co_return ( co_await p ) * 6;
+		};
+
+		auto p = ready();
+
+		REQUIRE( p.is_resolved() );
+
+		auto result = 0;
+
+		p.then( [&]( int val )
+		{
+			result = val;
+		} );
+
+		CHECK( result == 42 );
+	}
+
+	SUBCASE( "rejection" )
+	{
+		std::error_code caught;
+		std::error_code err;
+		auto			done = false;
+
+		propagate( caught ).then( [&]()
+		{
+			done = true;
+		},
+		[&]( std::error_code e )
+		{
+			err		= e;
+			done	= true;
+		} );
+
+		for ( auto i = 0; ( i < 1000 ) && !done; ++i )
+		{
+			runloop::shared().run( runloop::mode_t::nowait );
+		}
+
+		CHECK( caught == std::errc::connection_refused );
+		CHECK( err == std::errc::connection_refused );
+	}
+
+	SUBCASE( "timeout" )
+	{
+		auto waiting = []() -> promise< int >
+		{
+			promise< int > never;
+
+			co_return co_await never.timeout( std::chrono::milliseconds( 5 ) );
+		};
+
+		auto p = waiting();
+
+		for ( auto i = 0; ( i < 100000 ) && !p.is_finished(); ++i )
+		{
+			runloop::shared().run( runloop::mode_t::once );
+		}
+
+		CHECK( p.is_rejected() );
+	}
+}
+
+#endif
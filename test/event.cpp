@@ -27,6 +27,8 @@
 #include <nodeoze/event.h>
 #include <nodeoze/test.h>
 #include <system_error>
+#include <string>
+#include <vector>
 
 using namespace nodeoze;
 
@@ -102,4 +104,109 @@ TEST_CASE( "nodeoze/smoke/emitter" )
 
 		REQUIRE( invoked == true );
 	}
-}
\ No newline at end of file
+	SUBCASE( "once" )
+	{
+		event::emitter<> e;
+		int count = 0;
+
+		e.once( "test", [&]( int i )
+		{
+			count += i;
+		} );
+
+		e.emit( "test", 1 );
+		e.emit( "test", 1 );
+
+		REQUIRE( count == 1 );
+	}
+
+	SUBCASE( "mismatched signature" )
+	{
+		event::emitter<> e;
+		int ints = 0;
+		int strings = 0;
+
+		e.on( "test", [&]( int ) { ints++; } );
+		e.on( "test", [&]( std::string ) { strings++; } );
+
+		e.emit( "test", 7 );
+		e.emit( "test", std::string( "seven" ) );
+		e.emit( "test", 7.0 );
+
+		REQUIRE( ints == 1 );
+		REQUIRE( strings == 1 );
+	}
+
+	SUBCASE( "many listeners" )
+	{
+		event::emitter<> e;
+		std::vector< int > order;
+		std::vector< event::emitter<>::listener_id_type > ids;
+
+		for ( auto i = 0; i < 6; i++ )
+		{
+			ids.push_back( e.on( "test", [&order, i]() { order.push_back( i ); } ) );
+		}
+
+		e.emit( "test" );
+		REQUIRE( order == std::vector< int >{ 0, 1, 2, 3, 4, 5 } );
+
+		e.remove_listener( "test", ids[ 1 ] );
+		e.remove_listener( "test", ids[ 4 ] );
+		order.clear();
+		e.emit( "test" );
+		REQUIRE( order == std::vector< int >{ 0, 2, 3, 5 } );
+
+		e.remove_all_listeners( "test" );
+		order.clear();
+		e.emit( "test" );
+		REQUIRE( order.empty() );
+	}
+
+	SUBCASE( "modify while emitting" )
+	{
+		event::emitter<> e;
+		std::vector< int > order;
+		event::emitter<>::listener_id_type second = 0;
+
+		e.on( "test", [&]()
+		{
+			order.push_back( 0 );
+			e.remove_listener( "test", second );
+			e.on( "test", [&]() { order.push_back( 2 ); } );
+		} );
+
+		second = e.on( "test", [&]() { order.push_back( 1 ); } );
+
+		e.once( "test", [&]()
+		{
+			order.push_back( 3 );
+			e.emit( "test" );
+		} );
+
+		e.emit( "test" );
+
+		// the nested emit sees the listener added by the first, but not the removed or the once listener
+
+		REQUIRE( order == std::vector< int >{ 0, 3, 0, 2 } );
+	}
+
+	SUBCASE( "destroyed while emitting" )
+	{
+		auto e		= std::make_shared< event::emitter<> >();
+		auto calls	= 0;
+
+		e->on( "close", [&]()
+		{
+			calls++;
+			e.reset();
+		} );
+
+		e->on( "close", [&]() { calls++; } );
+
+		e->emit( "close" );
+
+		REQUIRE( !e );
+		REQUIRE( calls == 2 );
+	}
+}
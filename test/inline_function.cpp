@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2013-2017, Collobos Software Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <nodeoze/inline_function.h>
+#include <nodeoze/test.h>
+#include <memory>
+#include <string>
+#include <array>
+
+using namespace nodeoze;
+
+TEST_CASE( "nodeoze/smoke/inline_function" )
+{
+	SUBCASE( "empty" )
+	{
+		inline_function< void () > f;
+
+		CHECK( !f );
+		CHECK( f == nullptr );
+		CHECK_THROWS_AS( f(), std::bad_function_call );
+	}
+
+	SUBCASE( "inline" )
+	{
+		auto counter = std::make_shared< int >( 0 );
+
+		inline_function< int ( int ) > f = [counter]( int n )
+		{
+			return *counter += n;
+		};
+
+		CHECK( f != nullptr );
+		CHECK( f( 2 ) == 2 );
+
+		auto g = f;
+		CHECK( g( 3 ) == 5 );
+		CHECK( counter.use_count() == 3 );
+
+		auto h = std::move( f );
+		CHECK( !f );
+		CHECK( h( 1 ) == 6 );
+		CHECK( counter.use_count() == 3 );
+
+		h = nullptr;
+		g = nullptr;
+		CHECK( counter.use_count() == 1 );
+	}
+
+	SUBCASE( "heap" )
+	{
+		std::array< std::uint64_t, 16 > big;
+		big.fill( 7 );
+		auto counter = std::make_shared< int >( 0 );
+
+		inline_function< std::uint64_t () > f = [big, counter]()
+		{
+			return big[ 15 ];
+		};
+
+		auto g = f;
+		auto h = std::move( f );
+		CHECK( !f );
+		CHECK( g() == 7 );
+		CHECK( h() == 7 );
+		CHECK( counter.use_count() == 3 );
+
+		g = h;
+		h = nullptr;
+		CHECK( g() == 7 );
+		CHECK( counter.use_count() == 2 );
+	}
+
+	SUBCASE( "move only arguments" )
+	{
+		inline_function< std::string ( std::string&& ) > f = []( std::string &&s )
+		{
+			return std::move( s ) + "!";
+		};
+
+		CHECK( f( std::string( "hello" ) ) == "hello!" );
+	}
+}
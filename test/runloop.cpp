@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2013-2017, Collobos Software Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <nodeoze/runloop.h>
+#include <nodeoze/test.h>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace nodeoze;
+
+TEST_CASE( "nodeoze/smoke/runloop/group" )
+{
+	SUBCASE( "current" )
+	{
+		REQUIRE( &runloop::current() == &runloop::shared() );
+	}
+
+	SUBCASE( "dispatch" )
+	{
+		runloop_group			group( 3 );
+		std::mutex				mutex;
+		std::condition_variable	cond;
+		std::set< runloop* >	seen;
+		int						mismatches = 0;
+
+		REQUIRE( group.size() == 3 );
+
+		group.dispatch_all( [&]( runloop &loop )
+		{
+			std::lock_guard< std::mutex > lock( mutex );
+
+			if ( &runloop::current() != &loop )
+			{
+				++mismatches;
+			}
+
+			seen.insert( &loop );
+			cond.notify_one();
+		} );
+
+		std::unique_lock< std::mutex > lock( mutex );
+		REQUIRE( cond.wait_for( lock, std::chrono::seconds( 5 ), [&]() { return seen.size() == group.size(); } ) );
+		REQUIRE( mismatches == 0 );
+		REQUIRE( seen.count( &runloop::shared() ) == 0 );
+	}
+
+	SUBCASE( "next" )
+	{
+		runloop_group			group( 2 );
+		std::set< runloop* >	picked;
+
+		for ( auto i = 0; i < 4; ++i )
+		{
+			picked.insert( &group.next() );
+		}
+
+		REQUIRE( picked.size() == 2 );
+	}
+}
+
+TEST_CASE( "nodeoze/smoke/runloop/instrumentation" )
+{
+	auto &loop = runloop::shared();
+
+	std::vector< std::string >	slow;
+	auto						done = 0;
+
+	REQUIRE( loop.snapshot().iterations == 0 );
+
+	loop.instrument( true );
+	loop.trace_slow_callbacks( std::chrono::milliseconds( 2 ), [&]( const char *tag, std::chrono::microseconds elapsed )
+	{
+		CHECK( elapsed >= std::chrono::milliseconds( 2 ) );
+		slow.push_back( tag );
+	} );
+
+	// everything queued behind the slow one waits at least as long as it runs
+
+	loop.dispatch( [&]()
+	{
+		std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+		done++;
+	}, "sleepy" );
+
+	for ( auto i = 0; i < 10; ++i )
+	{
+		loop.dispatch( [&]()
+		{
+			done++;
+		} );
+	}
+
+	for ( auto i = 0; ( i < 100 ) && ( done < 11 ); ++i )
+	{
+		loop.run( runloop::mode_t::nowait );
+	}
+
+	loop.run( runloop::mode_t::nowait );
+	loop.run( runloop::mode_t::nowait );
+
+	auto health = loop.snapshot();
+
+	loop.trace_slow_callbacks( std::chrono::microseconds( 0 ), nullptr );
+	loop.instrument( false );
+
+	REQUIRE( done == 11 );
+	CHECK( slow == std::vector< std::string >{ "sleepy" } );
+	CHECK( health.slow_callbacks == 1 );
+	CHECK( health.iterations > 0 );
+	CHECK( health.lag.count > 0 );
+	CHECK( health.queue_wait.count == 11 );
+	CHECK( health.queue_wait.max >= 5000 );
+	CHECK( health.queue_depth.sum == 11 );
+	CHECK( health.queue_wait.percentile( 1.0 ) >= health.queue_wait.percentile( 0.5 ) );
+	CHECK( !loop.is_instrumented() );
+	CHECK( loop.snapshot().iterations == 0 );
+}
+
+TEST_CASE( "nodeoze/smoke/runloop/next_tick" )
+{
+	auto &loop = runloop::shared();
+
+	SUBCASE( "after each dispatch" )
+	{
+		std::vector< std::string > order;
+
+		loop.dispatch( [&]()
+		{
+			order.push_back( "a" );
+
+			loop.next_tick( [&]()
+			{
+				order.push_back( "tick" );
+
+				loop.next_tick( [&]()
+				{
+					order.push_back( "nested" );
+				} );
+			} );
+		} );
+
+		loop.dispatch( [&]()
+		{
+			order.push_back( "b" );
+		} );
+
+		for ( auto i = 0; ( i < 1000 ) && ( order.size() < 4 ); ++i )
+		{
+			loop.run( runloop::mode_t::nowait );
+		}
+
+		REQUIRE( order == std::vector< std::string >{ "a", "tick", "nested", "b" } );
+	}
+
+	SUBCASE( "after a timer" )
+	{
+		std::vector< std::string > order;
+
+		loop.schedule_oneshot_timer( std::chrono::milliseconds( 1 ), [&]( runloop::event )
+		{
+			order.push_back( "timer" );
+
+			loop.next_tick( [&]()
+			{
+				order.push_back( "tick" );
+			} );
+		} );
+
+		for ( auto i = 0; ( i < 100000 ) && ( order.size() < 2 ); ++i )
+		{
+			loop.run( runloop::mode_t::once );
+		}
+
+		REQUIRE( order == std::vector< std::string >{ "timer", "tick" } );
+	}
+
+	SUBCASE( "outside a callback" )
+	{
+		auto ran = false;
+
+		loop.next_tick( [&]()
+		{
+			ran = true;
+		} );
+
+		REQUIRE( !ran );
+
+		loop.run( runloop::mode_t::nowait );
+
+		REQUIRE( ran );
+	}
+}
+
+TEST_CASE( "nodeoze/smoke/runloop/event_pool" )
+{
+	auto &loop	= runloop::shared();
+	auto before	= loop.snapshot();
+
+	auto e = loop.create( std::chrono::milliseconds( 1000 ) );
+	REQUIRE( e );
+
+	auto created = loop.snapshot();
+	CHECK( created.events_live == before.events_live + 1 );
+
+	loop.cancel( e );
+	loop.run( runloop::mode_t::nowait );
+
+	auto closed = loop.snapshot();
+	CHECK( closed.events_live == before.events_live );
+	CHECK( closed.events_pooled >= 1 );
+
+	// the next event reuses the closed one
+
+	e = loop.create( std::chrono::milliseconds( 1000 ) );
+	REQUIRE( e );
+	CHECK( loop.snapshot().events_pooled == closed.events_pooled - 1 );
+
+	loop.cancel( e );
+	loop.run( runloop::mode_t::nowait );
+	CHECK( loop.snapshot().events_pooled == closed.events_pooled );
+}
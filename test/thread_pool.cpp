@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2013-2017, Collobos Software Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <nodeoze/thread_pool.h>
+#include <nodeoze/test.h>
+#include <atomic>
+
+using namespace nodeoze;
+
+static bool
+run_until( std::function< bool ( void ) > done )
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 10 );
+
+	while ( !done() && ( std::chrono::steady_clock::now() < deadline ) )
+	{
+		runloop::shared().run( runloop::mode_t::nowait );
+		std::this_thread::yield();
+	}
+
+	return done();
+}
+
+TEST_CASE( "nodeoze/smoke/thread_pool" )
+{
+	SUBCASE( "submit" )
+	{
+		thread_pool					pool( 4 );
+		auto						loop_thread = std::this_thread::get_id();
+		std::vector< int >			results( 200, -1 );
+		int							wrong_thread = 0;
+		int							done = 0;
+
+		for ( auto i = 0; i < 200; ++i )
+		{
+			pool.submit( [=]()
+			{
+				return i * i;
+			} )
+			.then( [&, i]( int val )
+			{
+				results[ i ] = val;
+
+				if ( std::this_thread::get_id() != loop_thread )
+				{
+					++wrong_thread;
+				}
+
+				++done;
+			} );
+		}
+
+		REQUIRE( run_until( [&]() { return done == 200; } ) );
+		CHECK( wrong_thread == 0 );
+
+		for ( auto i = 0; i < 200; ++i )
+		{
+			CHECK( results[ i ] == i * i );
+		}
+	}
+
+	SUBCASE( "void and errors" )
+	{
+		thread_pool			pool( 2 );
+		std::atomic< int >	ran( 0 );
+		std::error_code		err;
+		bool				resolved = false;
+
+		pool.submit( [&]()
+		{
+			++ran;
+		} )
+		.then( [&]()
+		{
+			resolved = true;
+		} );
+
+		pool.submit( [&]() -> int
+		{
+			throw std::system_error( make_error_code( std::errc::invalid_argument ) );
+		} )
+		.then( [&]( int )
+		{
+		},
+		[&]( std::error_code e )
+		{
+			err = e;
+		} );
+
+		REQUIRE( run_until( [&]() { return resolved && err; } ) );
+		CHECK( ran == 1 );
+		CHECK( err == std::errc::invalid_argument );
+	}
+
+	SUBCASE( "move-only results" )
+	{
+		thread_pool	pool( 2 );
+		int			value = 0;
+
+		pool.submit( []()
+		{
+			return std::make_unique< int >( 42 );
+		} )
+		.then( [&]( std::unique_ptr< int > p )
+		{
+			value = *p;
+		} );
+
+		REQUIRE( run_until( [&]() { return value != 0; } ) );
+		CHECK( value == 42 );
+	}
+
+	SUBCASE( "nested submit and bounded queues" )
+	{
+		thread_pool			pool( 2, 4 );
+		std::atomic< int >	inner( 0 );
+		std::atomic< bool >	release( false );
+		int					rejected = 0;
+		int					done = 0;
+
+		// park both workers so the deques fill up
+
+		for ( auto i = 0; i < 2; ++i )
+		{
+			pool.post( [&]()
+			{
+				while ( !release )
+				{
+					std::this_thread::yield();
+				}
+			} );
+		}
+
+		for ( auto i = 0; i < 16; ++i )
+		{
+			pool.submit( [&]()
+			{
+				return pool.post( [&]() { ++inner; } ).value();
+			} )
+			.then( [&]( int post_err )
+			{
+				CHECK( post_err == 0 );
+				++done;
+			},
+			[&]( std::error_code e )
+			{
+				CHECK( e == std::errc::resource_unavailable_try_again );
+				++rejected;
+			} );
+		}
+
+		release = true;
+
+		REQUIRE( run_until( [&]() { return ( done + rejected ) == 16; } ) );
+		CHECK( rejected > 0 );
+		CHECK( done > 0 );
+
+		pool.stop();
+
+		CHECK( inner == done );
+	}
+}
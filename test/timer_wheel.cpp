@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2013-2017, Collobos Software Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <nodeoze/timer_wheel.h>
+#include <nodeoze/test.h>
+#include <vector>
+
+using namespace nodeoze;
+
+static void
+run_until( const bool &done )
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 10 );
+
+	while ( !done && ( std::chrono::steady_clock::now() < deadline ) )
+	{
+		runloop::shared().run( runloop::mode_t::once );
+	}
+}
+
+TEST_CASE( "nodeoze/smoke/timer_wheel" )
+{
+	auto &wheel = runloop::shared().timers();
+
+	SUBCASE( "order" )
+	{
+		std::vector< int >	fired;
+		auto				start	= std::chrono::steady_clock::now();
+		auto				done	= false;
+
+		// 150 ms crosses two window boundaries, so those timers cascade down from level 1
+
+		wheel.schedule( std::chrono::milliseconds( 150 ), [&]()
+		{
+			fired.push_back( 150 );
+			done = true;
+		} );
+
+		wheel.schedule( std::chrono::milliseconds( 30 ), [&]() { fired.push_back( 30 ); } );
+		wheel.schedule( std::chrono::milliseconds( 0 ), [&]() { fired.push_back( 0 ); } );
+		wheel.schedule( std::chrono::milliseconds( 70 ), [&]() { fired.push_back( 70 ); } );
+
+		REQUIRE( wheel.size() == 4 );
+
+		run_until( done );
+
+		REQUIRE( done );
+		CHECK( fired == std::vector< int >{ 0, 30, 70, 150 } );
+		CHECK( ( std::chrono::steady_clock::now() - start ) >= std::chrono::milliseconds( 150 ) );
+		CHECK( wheel.size() == 0 );
+	}
+
+	SUBCASE( "cancel" )
+	{
+		auto fired	= 0;
+		auto done	= false;
+
+		std::vector< timer_wheel::timer > timers;
+
+		for ( auto i = 0; i < 1000; ++i )
+		{
+			timers.push_back( wheel.schedule( std::chrono::milliseconds( 5 + ( i % 100 ) ), [&]() { fired++; } ) );
+		}
+
+		for ( auto t : timers )
+		{
+			timer_wheel::cancel( t );
+		}
+
+		wheel.schedule( std::chrono::milliseconds( 120 ), [&]() { done = true; } );
+
+		run_until( done );
+
+		REQUIRE( done );
+		CHECK( fired == 0 );
+		CHECK( wheel.size() == 0 );
+	}
+
+	SUBCASE( "suspended when empty" )
+	{
+		auto done = false;
+
+		wheel.schedule( std::chrono::milliseconds( 30 ), [&]() { done = true; } );
+
+		CHECK( wheel.armed() );
+
+		run_until( done );
+
+		REQUIRE( done );
+		CHECK( wheel.size() == 0 );
+		CHECK( !wheel.armed() );
+
+		// cancelling the last timer stops the runloop timer too
+
+		auto t = wheel.schedule( std::chrono::seconds( 30 ), [&]() {} );
+
+		CHECK( wheel.armed() );
+
+		timer_wheel::cancel( t );
+
+		CHECK( wheel.size() == 0 );
+		CHECK( !wheel.armed() );
+	}
+
+	SUBCASE( "long timeout" )
+	{
+		auto done		= false;
+		auto wakeups	= 0;
+		auto deadline	= std::chrono::steady_clock::now() + std::chrono::seconds( 10 );
+
+		// the loop should wake for the cascade and the expiry, not once per 64 ms window
+
+		auto t = wheel.schedule( std::chrono::seconds( 30 ), [&]() {} );
+
+		wheel.schedule( std::chrono::milliseconds( 600 ), [&]() { done = true; } );
+
+		while ( !done && ( std::chrono::steady_clock::now() < deadline ) )
+		{
+			runloop::shared().run( runloop::mode_t::once );
+			wakeups++;
+		}
+
+		timer_wheel::cancel( t );
+
+		REQUIRE( done );
+		CHECK( wakeups <= 4 );
+		CHECK( !wheel.armed() );
+	}
+
+	SUBCASE( "schedule from callback" )
+	{
+		auto count	= 0;
+		auto done	= false;
+
+		std::function< void () > again = [&]()
+		{
+			if ( ++count == 5 )
+			{
+				done = true;
+			}
+			else
+			{
+				wheel.schedule( std::chrono::milliseconds( 0 ), again );
+			}
+		};
+
+		wheel.schedule( std::chrono::milliseconds( 1 ), again );
+
+		run_until( done );
+
+		CHECK( count == 5 );
+	}
+}